@@ -0,0 +1,295 @@
+// spyc-batch: evaluates many scripts in parallel and prints their results in
+// input order.
+//
+//   build: bison -d parser.y; flex lexer.l
+//          gcc -DSPYC_NO_MAIN parser.tab.c lex.yy.c batch.c -lpthread -o spyc-batch
+//   usage: spyc-batch [-j THREADS] [--no-trace] [--load-state FILE] DIR|MANIFEST...
+//
+// A directory contributes its regular files sorted by name; any other path is
+// a manifest listing one script per line. Each script gets its own Interp and
+// an in-memory output stream, so its display output and tables come out in
+// one piece under a "==> path <==" header no matter which thread ran it.
+// With --load-state every script starts from the same saved variable table.
+//
+// The job list and worker pool are allocated through spyc_mem.h under
+// "driver". Captured output (open_memstream) and manifest lines (getline) are
+// allocated by libc itself and are not in the SPYC_MEMSTATS report.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "parser.tab.h"
+#include "spyc_mem.h"
+
+typedef struct job {
+    char *path;
+    char *output;        // captured display output and tables
+    size_t outputLen;
+    int failed;          // unreadable, syntax error or reported errors
+    int done;
+} job;
+
+// Each worker owns a contiguous range of jobs and takes from its front.
+// An idle worker steals the back half of another worker's range.
+typedef struct jobRange {
+    pthread_mutex_t lock;
+    size_t head;
+    size_t tail;
+} jobRange;
+
+static job *jobs = NULL;
+static size_t jobCount = 0, jobCap = 0;
+
+static jobRange *ranges = NULL;
+static int workerCount = 1;
+static int traceEnabled = 1;
+static const char *statePath = NULL;
+
+static pthread_mutex_t doneLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;
+
+/*------------------------------ Job list ----------------------------------*/
+static int addJob(const char *path) {
+    if (jobCount == jobCap) {
+        size_t cap = jobCap ? jobCap * 2 : 1024;
+        job *grown = memRealloc(MEM_DRIVER, jobs, cap * sizeof(job));
+        if (!grown) return 0;
+        jobs = grown;
+        jobCap = cap;
+    }
+    memset(&jobs[jobCount], 0, sizeof(job));
+    jobs[jobCount].path = memStrdup(MEM_DRIVER, path);
+    if (!jobs[jobCount].path) return 0;
+    jobCount++;
+    return 1;
+}
+
+static int compareNames(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int addDirectory(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+
+    char **names = NULL;
+    size_t count = 0, cap = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        size_t len = strlen(dir) + strlen(entry->d_name) + 2;
+        char *path = memAlloc(MEM_DRIVER, len);
+        if (!path) break;
+        snprintf(path, len, "%s/%s", dir, entry->d_name);
+
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            memFree(path);
+            continue;
+        }
+        if (count == cap) {
+            cap = cap ? cap * 2 : 256;
+            char **grown = memRealloc(MEM_DRIVER, names, cap * sizeof(char *));
+            if (!grown) {
+                memFree(path);
+                break;
+            }
+            names = grown;
+        }
+        names[count++] = path;
+    }
+    closedir(d);
+
+    // readdir order depends on the file system; sort so runs are repeatable
+    qsort(names, count, sizeof(char *), compareNames);
+    int ok = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (ok && !addJob(names[i])) ok = 0;
+        memFree(names[i]);
+    }
+    memFree(names);
+    return ok;
+}
+
+static int addManifest(const char *path) {
+    FILE *in = fopen(path, "r");
+    if (!in) return 0;
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int ok = 1;
+    while (ok && (len = getline(&line, &cap, in)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+        if (len == 0 || line[0] == '#') continue;
+        ok = addJob(line);
+    }
+    free(line);
+    fclose(in);
+    return ok;
+}
+
+/*------------------------------ Evaluation --------------------------------*/
+// Same output as running ./a on the script, written to the job's buffer
+static void runJob(job *j) {
+    FILE *out = open_memstream(&j->output, &j->outputLen);
+    if (!out) {
+        j->failed = 1;
+        return;
+    }
+
+    Interp interp;
+    Interp *ctx = &interp;
+    interpInit(ctx, out);
+    if (!traceEnabled) setChannel(ctx, OUT_TRACE, NULL);
+
+    outPrintf(ctx, OUT_TABLES, "==> %s <==\n", j->path);
+    if (statePath && !loadState(ctx, statePath)) {
+        outPrintf(ctx, OUT_TABLES, "Could not load state %s\n", statePath);
+        j->failed = 1;
+    } else if (openInput(ctx, j->path)) {
+        outPrintf(ctx, OUT_TABLES, "Welcome to my Custom sPyC!\n");
+        j->failed = yyparse(ctx) != 0 || ctx->headErrList != NULL;
+        if (ctx->varCount) printVariableTable(ctx);
+        if (ctx->headErrList) printErrorTable(ctx);
+    } else {
+        outPrintf(ctx, OUT_TABLES, "Could not read input %s\n", j->path);
+        j->failed = 1;
+    }
+    interpFree(ctx);
+    fclose(out);
+}
+
+static int takeOwn(jobRange *r, size_t *index) {
+    int found = 0;
+    pthread_mutex_lock(&r->lock);
+    if (r->head < r->tail) {
+        *index = r->head++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return found;
+}
+
+// Moves the back half of some other worker's range into 'self'
+static int steal(int self) {
+    for (int k = 1; k < workerCount; k++) {
+        jobRange *victim = &ranges[(self + k) % workerCount];
+        size_t head = 0, tail = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail) {
+            head = victim->head + (victim->tail - victim->head) / 2;
+            tail = victim->tail;
+            victim->tail = head;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (head < tail) {
+            pthread_mutex_lock(&ranges[self].lock);
+            ranges[self].head = head;
+            ranges[self].tail = tail;
+            pthread_mutex_unlock(&ranges[self].lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void* worker(void *arg) {
+    int self = (int)(intptr_t)arg;
+    size_t index;
+    for (;;) {
+        if (!takeOwn(&ranges[self], &index)) {
+            if (!steal(self)) break;   // no jobs are ever added, so this is final
+            continue;
+        }
+        runJob(&jobs[index]);
+
+        pthread_mutex_lock(&doneLock);
+        jobs[index].done = 1;
+        pthread_cond_broadcast(&doneCond);
+        pthread_mutex_unlock(&doneLock);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    memReportAtExit();
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    workerCount = online > 0 ? (int)online : 1;
+
+    int sources = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            workerCount = atoi(argv[++i]);
+            if (workerCount < 1) workerCount = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--no-trace") == 0) {
+            traceEnabled = 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--load-state") == 0 && i + 1 < argc) {
+            statePath = argv[++i];
+            continue;
+        }
+        struct stat st;
+        int ok = stat(argv[i], &st) == 0 &&
+                 (S_ISDIR(st.st_mode) ? addDirectory(argv[i]) : addManifest(argv[i]));
+        if (!ok) {
+            fprintf(stderr, "Could not read script list %s\n", argv[i]);
+            return 2;
+        }
+        sources++;
+    }
+    if (!sources) {
+        fprintf(stderr, "usage: %s [-j THREADS] [--no-trace] [--load-state FILE] DIR|MANIFEST...\n", argv[0]);
+        return 2;
+    }
+    if ((size_t)workerCount > jobCount) workerCount = jobCount ? (int)jobCount : 1;
+
+    // Deal the jobs out in equal contiguous ranges; stealing evens out the rest
+    ranges = memCalloc(MEM_DRIVER, workerCount, sizeof(jobRange));
+    pthread_t *threads = memCalloc(MEM_DRIVER, workerCount, sizeof(pthread_t));
+    if (!ranges || !threads) {
+        fprintf(stderr, "Memory allocation failed for worker pool.\n");
+        return 2;
+    }
+    for (int w = 0; w < workerCount; w++) {
+        pthread_mutex_init(&ranges[w].lock, NULL);
+        ranges[w].head = jobCount * w / workerCount;
+        ranges[w].tail = jobCount * (w + 1) / workerCount;
+    }
+    for (int w = 0; w < workerCount; w++)
+        pthread_create(&threads[w], NULL, worker, (void *)(intptr_t)w);
+
+    // Flush in input order as soon as each prefix of jobs is complete
+    size_t failures = 0;
+    for (size_t i = 0; i < jobCount; i++) {
+        pthread_mutex_lock(&doneLock);
+        while (!jobs[i].done) pthread_cond_wait(&doneCond, &doneLock);
+        pthread_mutex_unlock(&doneLock);
+
+        if (jobs[i].output) fwrite(jobs[i].output, 1, jobs[i].outputLen, stdout);
+        if (jobs[i].failed) failures++;
+        free(jobs[i].output);   // open_memstream's buffer
+        memFree(jobs[i].path);
+    }
+
+    // Idle workers may still be probing other ranges, so join them all first
+    for (int w = 0; w < workerCount; w++) pthread_join(threads[w], NULL);
+    for (int w = 0; w < workerCount; w++) pthread_mutex_destroy(&ranges[w].lock);
+    memFree(threads);
+    memFree(ranges);
+    memFree(jobs);
+
+    fprintf(stderr, "%zu scripts, %zu with errors\n", jobCount, failures);
+    return failures ? 1 : 0;
+}
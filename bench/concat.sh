@@ -0,0 +1,27 @@
+#!/bin/sh
+# Times one display statement that concatenates N pieces (10k and up),
+# alternating string literals, ints and chars. Cost should grow linearly.
+#
+#   usage: bench/concat.sh [path-to-interpreter]    (defaults to ./a)
+
+SPYC=${1:-./a}
+TMP=${TMPDIR:-/tmp}/spyc-concat.$$
+trap 'rm -f "$TMP"' EXIT
+
+for n in 10000 20000 40000 80000; do
+    awk -v n="$n" 'BEGIN {
+        printf "string s = \"piece\";\ndisplay(s";
+        for (i = 1; i < n; i++) {
+            if (i % 3 == 0) printf " + %d", i;
+            else if (i % 3 == 1) printf " + \"-str-\"";
+            else printf " + '\''c'\''";
+        }
+        printf ");\n";
+    }' > "$TMP"
+
+    start=$(date +%s.%N)
+    "$SPYC" < "$TMP" > /dev/null
+    end=$(date +%s.%N)
+
+    echo "$n $start $end" | awk '{ t = $3 - $2; printf "pieces=%-6d %.3fs  %.1f ns/piece\n", $1, t, t * 1e9 / $1 }'
+done
@@ -0,0 +1,69 @@
+#!/bin/sh
+# Writes a synthetic sPyC program to stdout, scaled by COUNT statements.
+#
+#   usage: bench/gen.sh KIND COUNT [DEPTH]
+#
+#   decls    COUNT int declarations, then COUNT reassignments
+#   depth    COUNT declarations of expressions nested DEPTH parentheses deep
+#   concat   COUNT displays, each concatenating DEPTH strings, ints and chars
+#   display  COUNT displays alternating ints, strings and arithmetic
+#   exprs    COUNT pure expression statements (MIPS64 front end only; the
+#            interpreter grammar has no expression statements)
+#
+# DEPTH defaults to 16. Every program is error free, so the interpreter runs
+# it to the end instead of stopping at the first syntax error.
+
+KIND=$1
+COUNT=$2
+DEPTH=${3:-16}
+
+if [ -z "$KIND" ] || [ -z "$COUNT" ]; then
+    echo "usage: $0 decls|depth|concat|display|exprs COUNT [DEPTH]" >&2
+    exit 2
+fi
+
+case $KIND in
+decls)
+    awk -v n="$COUNT" 'BEGIN {
+        for (i = 0; i < n; i++) printf "int v%d = %d;\n", i, i % 1000;
+        for (i = 0; i < n; i++) printf "v%d = %d + %d;\n", i, i % 1000, i % 7;
+    }' ;;
+depth)
+    # ((((1 + 2) - 3) + 4) ...) stays small, so no statement overflows
+    awk -v n="$COUNT" -v d="$DEPTH" 'BEGIN {
+        for (i = 0; i < n; i++) {
+            printf "int d%d = ", i;
+            for (k = 0; k < d; k++) printf "(";
+            printf "1";
+            for (k = 0; k < d; k++) printf " %s %d)", k % 2 ? "-" : "+", k % 9 + 1;
+            printf ";\n";
+        }
+    }' ;;
+concat)
+    awk -v n="$COUNT" -v d="$DEPTH" 'BEGIN {
+        for (i = 0; i < n; i++) {
+            printf "display(\"s%d\"", i;
+            for (k = 1; k < d; k++) {
+                if (k % 3 == 0) printf " + %d", k;
+                else if (k % 3 == 1) printf " + \"-str-\"";
+                else printf " + '\''c'\''";
+            }
+            printf ");\n";
+        }
+    }' ;;
+display)
+    awk -v n="$COUNT" 'BEGIN {
+        for (i = 0; i < n; i++) {
+            if (i % 3 == 0) printf "display(%d);\n", i;
+            else if (i % 3 == 1) printf "display(\"line %d\");\n", i;
+            else printf "display(%d * 2 + (%d - 1));\n", i % 1000, i % 100;
+        }
+    }' ;;
+exprs)
+    awk -v n="$COUNT" 'BEGIN {
+        for (i = 0; i < n; i++) printf "%d * 3 + (%d - 1);\n", i % 1000, i % 100;
+    }' ;;
+*)
+    echo "$0: unknown workload $KIND" >&2
+    exit 2 ;;
+esac
@@ -0,0 +1,88 @@
+#!/bin/sh
+# Times each compiler stage separately on the bench/gen.sh workloads and
+# prints one row per (workload, size, stage) as CSV or JSON, so runs can be
+# diffed to catch regressions.
+#
+#   usage: bench/stages.sh [-f csv|json] [-n "SIZES"] [-d DEPTH]
+#                          [path-to-interpreter] [path-to-mips-frontend]
+#          (defaults: csv, "1000 10000 100000", 16, ./a, parser/test)
+#
+# Stages:
+#   lex                       interpreter --lex-only (Flex alone)
+#   parse_eval                interpreter yyparse: Bison, evaluation and the
+#                             scanning the parser pulls on demand
+#   front_end                 parser/test.c reading input.txt into the AST
+#   generate_mips64           parser/test.c writing output.txt
+#   convert_mips64_to_binhex  parser/test.c encoding output.txt
+#
+# Every stage is timed inside the program itself (SPYC_STAGE_TIMES), so
+# process start and input loading are not counted. parser/test.c runs in a
+# scratch directory because it always reads input.txt and writes output.txt.
+
+FORMAT=csv
+SIZES="1000 10000 100000"
+DEPTH=16
+while getopts f:n:d: opt; do
+    case $opt in
+    f) FORMAT=$OPTARG ;;
+    n) SIZES=$OPTARG ;;
+    d) DEPTH=$OPTARG ;;
+    *) exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+SPYC=${1:-./a}
+MIPS=${2:-parser/test}
+case $SPYC in /*) ;; *) SPYC=$PWD/$SPYC ;; esac
+case $MIPS in /*) ;; *) MIPS=$PWD/$MIPS ;; esac
+GEN=$(dirname "$0")/gen.sh
+
+WORK=${TMPDIR:-/tmp}/spyc-stages.$$
+mkdir -p "$WORK" || exit 1
+trap 'rm -rf "$WORK"' EXIT
+ROWS=$WORK/rows
+
+# row KIND SIZE BYTES STAGE SECONDS
+row() {
+    echo "$1,$2,$3,$4,$5" >> "$ROWS"
+}
+
+# stage_rows KIND SIZE BYTES: one row per "stage NAME SECONDS" line on stdin
+stage_rows() {
+    awk '$1 == "stage" { print $2, $3 }' | while read -r stage secs; do
+        row "$1" "$2" "$3" "$stage" "$secs"
+    done
+}
+
+: > "$ROWS"
+for size in $SIZES; do
+    for kind in decls depth concat display exprs; do
+        prog=$WORK/$kind.spc
+        sh "$GEN" "$kind" "$size" "$DEPTH" > "$prog"
+        bytes=$(wc -c < "$prog" | tr -d ' ')
+
+        if [ "$kind" != exprs ] && [ -x "$SPYC" ]; then
+            SPYC_STAGE_TIMES=1 "$SPYC" --lex-only "$prog" > /dev/null 2> "$WORK/stages.txt"
+            SPYC_STAGE_TIMES=1 "$SPYC" --no-trace "$prog" > /dev/null 2>> "$WORK/stages.txt"
+            stage_rows "$kind" "$size" "$bytes" < "$WORK/stages.txt"
+        fi
+
+        # The MIPS64 front end only knows int and char
+        if { [ "$kind" = decls ] || [ "$kind" = depth ] || [ "$kind" = exprs ]; } && [ -x "$MIPS" ]; then
+            cp "$prog" "$WORK/input.txt"
+            (cd "$WORK" && SPYC_STAGE_TIMES=1 "$MIPS" > /dev/null 2> stages.txt)
+            stage_rows "$kind" "$size" "$bytes" < "$WORK/stages.txt"
+        fi
+    done
+done
+
+if [ "$FORMAT" = json ]; then
+    awk -F, 'BEGIN { print "[" }
+        { printf "%s  {\"workload\": \"%s\", \"size\": %s, \"bytes\": %s, \"stage\": \"%s\", \"seconds\": %s}",
+                 (NR > 1 ? ",\n" : ""), $1, $2, $3, $4, $5 }
+        END { print "\n]" }' "$ROWS"
+else
+    echo "workload,size,bytes,stage,seconds"
+    cat "$ROWS"
+fi
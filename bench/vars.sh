@@ -0,0 +1,22 @@
+#!/bin/sh
+# Declares and reassigns N variables at doubling sizes up to 1M so the
+# symbol table cost per statement can be checked for linear scaling.
+#
+#   usage: bench/vars.sh [path-to-interpreter]    (defaults to ./a)
+
+SPYC=${1:-./a}
+TMP=${TMPDIR:-/tmp}/spyc-vars.$$
+trap 'rm -f "$TMP"' EXIT
+
+for n in 125000 250000 500000 1000000; do
+    awk -v n="$n" 'BEGIN {
+        for (i = 0; i < n; i++) printf "int v%d = %d;\n", i, i;
+        for (i = 0; i < n; i++) printf "v%d = v%d + 1;\n", i, i;
+    }' > "$TMP"
+
+    start=$(date +%s.%N)
+    "$SPYC" < "$TMP" > /dev/null
+    end=$(date +%s.%N)
+
+    echo "$n $start $end" | awk '{ t = $3 - $2; printf "vars=%-8d %.3fs  %.1f ns/stmt\n", $1, t, t * 1e9 / ($1 * 2) }'
+done
@@ -5,6 +5,34 @@
 #include <string.h>
 #include <stdarg.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define SPYC_MEM_IMPLEMENTATION
+#include "spyc_mem.h"
+
+#define NO_SYMBOL (-1)
+
+// Stack-machine instructions recorded by --compile and executed by --run
+typedef enum {
+    OP_HALT,
+    OP_LINE,         // line       : sets the line reported by the next effect
+    OP_PUSH_INT,     // value
+    OP_PUSH_CHAR,    // char
+    OP_PUSH_STR,     // pool index
+    OP_LOAD,         // sym        : typed value, as display_arg sees it
+    OP_LOAD_INT,     // sym        : numeric value, as expression sees it
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_NEG,        // expression arithmetic
+    OP_DADD, OP_DSUB, OP_DMUL, OP_DDIV, OP_DNEG,   // display arithmetic/concatenation
+    OP_DECL,         // sym, type  : pops the initial value
+    OP_STORE,        // sym        : pops the new value
+    OP_DISPLAY,      //            : pops and prints
+    OP_COUNT
+} opcode;
 
 typedef struct errorList{
    int line_error;
@@ -13,15 +41,22 @@ typedef struct errorList{
 }errorList;
 
 
-// Symbol table structure
+// Symbol table record, kept by value in Interp.varTable in declaration order.
+// Strings up to VAR_INLINE_MAX bytes are stored in the record itself; longer
+// ones are shared (see stringNew()). Record pointers are only valid until the
+// next declaration grows the table.
+#define VAR_INLINE_MAX 15
+#define VAR_SHARED 0xFF   // inlineLen of a record holding a shared string
+
 typedef struct vars{
-    char *id;
-    int data_type;
+    int sym;                   // name comes from symbolName()
+    char data_type;
+    unsigned char inlineLen;   // string length when inline, else VAR_SHARED
     union {
-        int val;      // for int/char
-        char *str_val; // for string
+        int val;                        // for int/char
+        char *str_val;                  // for long strings: shared, immutable
+        char inl[VAR_INLINE_MAX + 1];   // for short strings, NUL-terminated
     } data;
-    struct vars *next;
 } vars;
 
 typedef struct logs{
@@ -31,54 +66,222 @@ typedef struct logs{
     struct logs *next;
 }logs;
 
-
-vars *headVars = NULL;
-vars *tailVars = NULL;
-errorList *headErrList = NULL;
-errorList *tailErrList = NULL;
-logs *headLogs = NULL;
-logs *tailLogs = NULL;
-char *currentDataType = NULL;
-char *currentVarBeingDeclared = NULL;  // Track variable being declared
-int isRecovering = 0;
-int hasError = 0;
-
-extern int yylineno;
-extern int yylex();
-void yyerror(const char *fmt, ...);
-void printErrorTable();
-void cleanupErrorTable();
-int getVariableValue(char *variableName);
-void cleanupVariableTable();
-const char* typeName(char dt);
-vars* getVariable(char* variable);
-void createVariable(char *DTYPE, char* variable, int val, char *str_val);
-void variableReAssignment(char* variable, int val, char *str_val);
-void printVariableTable();
 %}
 
+%define api.pure full
+%define api.push-pull both
+%parse-param {Interp *ctx}
+%lex-param {Interp *ctx}
+
 // Define Disp struct BEFORE %union so it's available in parser.tab.h
 %code requires {
+    #include <stdio.h>
+    #include <stddef.h>
+    #include <stdint.h>
+
+    #ifndef YY_TYPEDEF_YY_SCANNER_T
+    #define YY_TYPEDEF_YY_SCANNER_T
+    typedef void* yyscan_t;
+    #endif
+
+    // Borrowed, length-delimited text; not NUL-terminated
     typedef struct {
-        int type;      // 1=string 2=char 3=int 4=id  
-        char* text;    // always printable
+        const char *ptr;
+        size_t len;
+    } StrView;
+
+    // One piece of a concatenated display string
+    typedef struct ropePiece {
+        struct ropePiece *next;
+        StrView text;
+        char scratch[12];   // backing store when the piece is a formatted int/char
+    } ropePiece;
+
+    // Typed display operand; text is only produced by the final printf
+    typedef struct {
+        int type;      // 1=string 2=char 3=int 4=id (error)
+        union {
+            int num;       // type 3
+            char ch;       // type 2
+            StrView str;   // type 1, unless it is a concatenation
+        };
+        char *shared;       // type 1: variable string 'str' covers, NULL otherwise
+        ropePiece *pieces;  // type 1 concatenation, flattened only when printed
+        ropePiece *last;
     } Disp;
+
+    // Bytecode being recorded (--compile) or executed (--run)
+    typedef struct program {
+        uint32_t *code;
+        size_t codeLen;
+        size_t codeCap;
+        StrView *strings;      // constant pool, views into the source or the loaded image
+        size_t strCount;
+        size_t strCap;
+        int depth;
+        int maxDepth;
+        int lastLine;
+        int constRun;          // OP_PUSH_INT instructions ending the code, for folding
+        char *image;           // file contents when loaded with --run
+    } program;
+
+    // Cost of the statements ending on one source line (--profile)
+    typedef struct lineProfile {
+        uint64_t runs;
+        uint64_t nanos;
+        uint64_t lookups;       // variable and name table lookups
+        uint64_t heapBytes;     // variable table slots and shared string copies
+        uint64_t arenaBytes;    // statement arena, reclaimed whole at statement ends
+        uint64_t outBytes;
+    } lineProfile;
+
+    // Output channels; each can go to its own stream or be switched off
+    enum {
+        OUT_DISPLAY,     // display statements
+        OUT_TRACE,       // "Variable ... created/updated" messages
+        OUT_TABLES,      // banner, variable and error tables, REPL diagnostics
+        OUT_CHANNELS
+    };
+
+    // Everything one script evaluation touches. Independent contexts can be
+    // used from different threads at the same time.
+    typedef struct Interp {
+        yyscan_t scanner;
+        int line;                        // line reported by diagnostics and display
+        FILE *channel[OUT_CHANNELS];     // destination per channel, NULL = disabled
+        char *outBuf;                    // pending bytes for outDest
+        size_t outLen;
+        FILE *outDest;
+
+        struct vars *varTable;           // declaration order
+        int varCount;
+        int varCap;
+        int *symVars;                    // symbol ID -> table index + 1, 0 if undeclared
+        struct errorList *headErrList;
+        struct errorList *tailErrList;
+        char *currentDataType;
+        int currentVarBeingDeclared;     // Track variable being declared
+        int isRecovering;
+        int hasError;
+
+        struct nameBlock *nameBlocks;    // interned identifier storage
+        const char **symNames;           // symbol ID -> interned name
+        int symCount;
+        int symCap;
+        int *symIndex;                   // open addressing over names: symbol ID + 1, 0 = empty
+        size_t symIndexCap;              // always a power of two
+
+        struct arenaChunk *arenaHead;    // statement arena
+        struct arenaChunk *arenaCur;
+
+        int compiling;                   // record bytecode while evaluating
+        program prog;
+
+        int profiling;
+        lineProfile *profLines;          // indexed by line number
+        int profLineCap;
+        uint64_t profMark;               // time of the last statement boundary
+        lineProfile profPending;         // counted since then; kept even when not profiling
+
+        char *inputBase;                 // whole script, scanned in place
+        size_t inputMapped;              // mapping length, 0 when inputBase is heap memory
+        void *inputBuffer;
+    } Interp;
+}
+
+// Shared with the lexer and with programs embedding the interpreter
+%code provides {
+    void interpInit(Interp *ctx, FILE *out);
+    void interpFree(Interp *ctx);
+    int openInput(Interp *ctx, const char *path);
+    int openInputBuffer(Interp *ctx, const char *text, size_t len);
+    void closeInput(Interp *ctx);
+    int feedInput(Interp *ctx, char *text, size_t len, int line);
+    int runRepl(Interp *ctx, FILE *in);
+    long scanOnly(Interp *ctx);
+    void printVariableTable(Interp *ctx);
+    void printErrorTable(Interp *ctx);
+    int saveState(Interp *ctx, const char *path);
+    void profileStart(Interp *ctx);
+    void profileStatement(Interp *ctx);
+    void profileStop(Interp *ctx);
+    void printProfile(Interp *ctx);
+    int loadState(Interp *ctx, const char *path);
+    void setChannel(Interp *ctx, int channel, FILE *dest);
+    void outWrite(Interp *ctx, int channel, const char *text, size_t len);
+    void outPrintf(Interp *ctx, int channel, const char *fmt, ...);
+    void outFlush(Interp *ctx);
+
+    int internName(Interp *ctx, const char *text, size_t len);
+    const char* symbolName(Interp *ctx, int sym);
+    void* arenaAlloc(Interp *ctx, size_t size);
+    char* arenaCopy(Interp *ctx, const char *text, size_t len);
+}
+
+%code {
+    int yylex(YYSTYPE *yylval_param, yyscan_t yyscanner);
+    // The grammar only passes the context around; the scanner hangs off it
+    #define yylex(lvalp, ctx) yylex(lvalp, (ctx)->scanner)
+
+    void yyerror(Interp *ctx, const char *fmt, ...);
+    void cleanupErrorTable(Interp *ctx);
+    int getVariableValue(Interp *ctx, int sym);
+    void cleanupVariableTable(Interp *ctx);
+    const char* typeName(char dt);
+    vars* getVariable(Interp *ctx, int sym);
+    // String operand of an assignment; 'shared' is set when the text already
+    // belongs to a shared string that can be referenced instead of copied
+    typedef struct {
+        StrView text;
+        char *shared;
+    } strValue;
+
+    void createVariable(Interp *ctx, const char *DTYPE, int sym, int val, const strValue *str_val);
+    void variableReAssignment(Interp *ctx, int sym, int val, const strValue *str_val);
+    StrView varString(const vars *v);
+    strValue variableString(const vars *v);
+    size_t setVarString(vars *v, const strValue *str);
+    void releaseVarString(vars *v);
+    int appendVariable(Interp *ctx, const vars *record);
+    void cleanupSymbolNames(Interp *ctx);
+    StrView viewOf(const char *str);
+    char* stringNew(StrView str);
+    char* stringRetain(char *text);
+    void stringRelease(char *text);
+    StrView stringView(const char *text);
+
+    int dispNumber(const Disp *d);
+    void concatDisp(Interp *ctx, Disp *out, Disp *left, Disp *right);
+    void printDisp(Interp *ctx, const Disp *d);
+
+    void arenaReset(Interp *ctx);
+    void arenaRelease(Interp *ctx);
+
+    void emit(Interp *ctx, int op, int operand);
+    void emitEffect(Interp *ctx, int op, int sym, int dataType);
+    void emitString(Interp *ctx, StrView str);
+    int saveProgram(Interp *ctx, const char *path);
+    int loadProgram(Interp *ctx, const char *path);
+    int runProgram(Interp *ctx);
+    void cleanupProgram(Interp *ctx);
 }
 
 %union {
     int num;
+    int sym;        // interned identifier
+    StrView text;   // string literal, points into the scanner input
     char character;
     char *str;
     Disp  disp;
 }
 
 %token <str> DATA_TYPE
-%token <str> VARIABLE
+%token <sym> VARIABLE
 %token ASSIGNMENT
 %token DISPLAY
 %token COMMA
 %token SEMI
-%token <str> STRING 
+%token <text> STRING 
 %token <num> INTEGER
 %token <character> CHARACTER
 
@@ -100,250 +303,167 @@ program:
 
 
 statement_list:
-    statement_list statement
+    statement_list statement {
+        if(ctx->profiling) profileStatement(ctx);
+        // Everything the statement allocated from the arena is dead now,
+        // unless a lookahead token already points into it
+        if(yychar == YYEMPTY) arenaReset(ctx);
+    }
     | /* empty */
     ;
 
 statement:
     display_statement {
-        if(hasError) YYABORT;
+        if(ctx->hasError) YYABORT;
     }
     | declaration_statement {
-        if(hasError) YYABORT;
+        if(ctx->hasError) YYABORT;
     }
     | assignment_statement {
-        if(hasError) YYABORT;
+        if(ctx->hasError) YYABORT;
     }
     | error SEMI { 
         yyerrok; 
-        hasError = 1;
+        ctx->hasError = 1;
         YYABORT;
     }
     ; 
 
 display_statement:
     DISPLAY '(' display_arg ')' SEMI {
-        if(hasError) {
-            if($3.text != NULL) free($3.text);
+        if(ctx->hasError) {
             YYABORT;
         }
-        if($3.text != NULL){
-            printf("LINE %d: %s\n", yylineno, $3.text);
-            free($3.text);
+        if($3.type != 4){
+            outPrintf(ctx, OUT_DISPLAY, "LINE %d: ", ctx->line);
+            printDisp(ctx, &$3);
+            outWrite(ctx, OUT_DISPLAY, "\n", 1);
         }
+        emitEffect(ctx, OP_DISPLAY, 0, 0);
     }
     ;
 
 display_arg:
     STRING { 
-        $$.text = strdup($1);
         $$.type = 1;
-        free($1);
+        $$.str = $1;
+        $$.pieces = NULL;
+        emitString(ctx, $1);
     }
     | CHARACTER { 
-        char buffer[2];
-        buffer[0] = $1;
-        buffer[1] = '\0';
-        $$.text = strdup(buffer);
         $$.type = 2;
+        $$.ch = $1;
+        $$.pieces = NULL;
+        emit(ctx, OP_PUSH_CHAR, (unsigned char)$1);
     }
     | VARIABLE {
-        vars *var = getVariable($1);
+        vars *var = getVariable(ctx, $1);
+        $$.pieces = NULL;
+        emit(ctx, OP_LOAD, $1);
         if(!var){
-            yyerror("Undefined variable '%s' on line %d", $1, yylineno);
-            hasError = 1;
-            $$.text = NULL;
+            yyerror(ctx, "Undefined variable '%s' on line %d", symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
             $$.type = 4;
+        } else if(var->data_type == 's'){
+            // Borrow the stored value; nothing can reassign it mid-statement
+            $$.type = 1;
+            $$.str = varString(var);
+        } else if(var->data_type == 'c'){
+            $$.type = 2;
+            $$.ch = (char)var->data.val;
         } else {
-            if(var->data_type == 's'){
-                $$.text = strdup(var->data.str_val);
-                $$.type = 1;
-            } else if(var->data_type == 'c'){
-                char buffer[2];
-                buffer[0] = (char)var->data.val;
-                buffer[1] = '\0';
-                $$.text = strdup(buffer);
-                $$.type = 2;
-            } else {
-                char buffer[20];
-                sprintf(buffer, "%d", var->data.val);
-                $$.text = strdup(buffer);
-                $$.type = 3;
-            }
+            $$.type = 3;
+            $$.num = var->data.val;
         }
-        free($1);
     }
     | INTEGER {
-        char buffer[20];
-        sprintf(buffer, "%d", $1);
-        $$.text = strdup(buffer);
         $$.type = 3;
+        $$.num = $1;
+        $$.pieces = NULL;
+        emit(ctx, OP_PUSH_INT, $1);
     }
     | '(' expression ')' {
-        char buffer[20];
-        sprintf(buffer, "%d", $2);
-        $$.text = strdup(buffer);
         $$.type = 3;
+        $$.num = $2;
+        $$.pieces = NULL;
     }
     | display_arg '+' display_arg {
-        if(hasError) {
-            if($1.text) free($1.text);
-            if($3.text) free($3.text);
-            $$.text = NULL;
-            $$.type = 4;
-            YYERROR;
-        }
-        if($1.text == NULL || $3.text == NULL) {
-            $$.text = NULL;
+        if(ctx->hasError || $1.type == 4 || $3.type == 4) {
             $$.type = 4;
-            if($1.text) free($1.text);
-            if($3.text) free($3.text);
+            $$.pieces = NULL;
             YYERROR;
         } else if($1.type == 1 || $3.type == 1) {
-            // String concatenation: if either operand is a string
-            size_t len = strlen($1.text) + strlen($3.text) + 1;
-            $$.text = malloc(len);
-            if($$.text) {
-                strcpy($$.text, $1.text);
-                strcat($$.text, $3.text);
-                $$.type = 1;  // Result is a string
-            } else {
-                yyerror("Memory allocation failed on line %d", yylineno);
-                $$.text = NULL;
-                $$.type = 4;
-                hasError = 1;
-            }
-            free($1.text);
-            free($3.text);
+            // String concatenation: if either operand is a string.
+            // Links the pieces of both sides, no bytes are copied here
+            concatDisp(ctx, &$$, &$1, &$3);
         } else {
             // Numeric addition
-            int val1 = atoi($1.text);
-            int val2 = atoi($3.text);
-            char buffer[20];
-            sprintf(buffer, "%d", val1 + val2);
-            $$.text = strdup(buffer);
             $$.type = 3;
-            free($1.text);
-            free($3.text);
+            $$.num = dispNumber(&$1) + dispNumber(&$3);
+            $$.pieces = NULL;
         }
+        emit(ctx, OP_DADD, 0);
     }
     | display_arg '-' display_arg {
-        if(hasError) {
-            if($1.text) free($1.text);
-            if($3.text) free($3.text);
-            $$.text = NULL;
+        if(ctx->hasError || $1.type == 4 || $3.type == 4) {
             $$.type = 4;
+            $$.pieces = NULL;
             YYERROR;
         }
-        if($1.text == NULL || $3.text == NULL) {
-            $$.text = NULL;
-            $$.type = 4;
-            if($1.text) free($1.text);
-            if($3.text) free($3.text);
-            YYERROR;
-        } else {
-            int val1 = atoi($1.text);
-            int val2 = atoi($3.text);
-            char buffer[20];
-            sprintf(buffer, "%d", val1 - val2);
-            $$.text = strdup(buffer);
-            $$.type = 3;
-            free($1.text);
-            free($3.text);
-        }
+        $$.type = 3;
+        $$.num = dispNumber(&$1) - dispNumber(&$3);
+        $$.pieces = NULL;
+        emit(ctx, OP_DSUB, 0);
     }
     | display_arg '*' display_arg {
-        if(hasError) {
-            if($1.text) free($1.text);
-            if($3.text) free($3.text);
-            $$.text = NULL;
+        if(ctx->hasError || $1.type == 4 || $3.type == 4) {
             $$.type = 4;
+            $$.pieces = NULL;
             YYERROR;
         }
-        if($1.text == NULL || $3.text == NULL) {
-            $$.text = NULL;
-            $$.type = 4;
-            if($1.text) free($1.text);
-            if($3.text) free($3.text);
-            YYERROR;
-        } else {
-            int val1 = atoi($1.text);
-            int val2 = atoi($3.text);
-            char buffer[20];
-            sprintf(buffer, "%d", val1 * val2);
-            $$.text = strdup(buffer);
-            $$.type = 3;
-            free($1.text);
-            free($3.text);
-        }
+        $$.type = 3;
+        $$.num = dispNumber(&$1) * dispNumber(&$3);
+        $$.pieces = NULL;
+        emit(ctx, OP_DMUL, 0);
     }
     | display_arg '/' display_arg {
-        if(hasError) {
-            if($1.text) free($1.text);
-            if($3.text) free($3.text);
-            $$.text = NULL;
+        if(ctx->hasError || $1.type == 4 || $3.type == 4) {
             $$.type = 4;
+            $$.pieces = NULL;
             YYERROR;
         }
-        if($1.text == NULL || $3.text == NULL) {
-            $$.text = NULL;
+        int val1 = dispNumber(&$1);
+        int val2 = dispNumber(&$3);
+        $$.pieces = NULL;
+        if(val2 == 0){
+            yyerror(ctx, "Division by zero in display on line %d", ctx->line);
+            ctx->hasError = 1;
             $$.type = 4;
-            if($1.text) free($1.text);
-            if($3.text) free($3.text);
             YYERROR;
-        } else {
-            int val1 = atoi($1.text);
-            int val2 = atoi($3.text);
-            if(val2 == 0){
-                yyerror("Division by zero in display on line %d", yylineno);
-                hasError = 1;
-                $$.text = NULL;
-                free($1.text);
-                free($3.text);
-                YYERROR;
-            } else {
-                char buffer[20];
-                sprintf(buffer, "%d", val1 / val2);
-                $$.text = strdup(buffer);
-            }
-            $$.type = 3;
-            free($1.text);
-            free($3.text);
         }
+        $$.type = 3;
+        $$.num = val1 / val2;
+        emit(ctx, OP_DDIV, 0);
     }
     | '-' display_arg %prec UMINUS {
-        if($2.text == NULL) {
-            $$.text = NULL;
-            $$.type = 4;
+        if($2.type == 4) {
+            $$ = $2;
         } else {
-            int val = atoi($2.text);
-            char buffer[20];
-            sprintf(buffer, "%d", -val);
-            $$.text = strdup(buffer);
             $$.type = 3;
-            free($2.text);
+            $$.num = -dispNumber(&$2);
+            $$.pieces = NULL;
         }
+        emit(ctx, OP_DNEG, 0);
     }
     | '+' display_arg %prec UMINUS {
-        if($2.text == NULL) {
-            $$.text = NULL;
-            $$.type = 4;
-        } else {
-            $$ = $2;
-        }
+        $$ = $2;
     }
     ;
 
 declaration_statement:
     data_type declaration_list SEMI {
-        if(currentDataType) {
-            free(currentDataType);
-            currentDataType = NULL;
-        }
-        if(currentVarBeingDeclared) {
-            free(currentVarBeingDeclared);
-            currentVarBeingDeclared = NULL;
-        }
+        ctx->currentDataType = NULL;
+        ctx->currentVarBeingDeclared = NO_SYMBOL;
     }
     ;
 
@@ -353,8 +473,8 @@ assignment_statement:
 
 data_type:
     DATA_TYPE {
-        currentDataType = strdup($1);
-        $$ = currentDataType;
+        ctx->currentDataType = $1;
+        $$ = ctx->currentDataType;
     }
     ;
 
@@ -367,130 +487,105 @@ declaration_list:
 var_decl:
     VARIABLE {
         // Initialize with default value: 0 for int/char, empty for string
-        if(strcmp(currentDataType, "string") == 0) {
-            createVariable(currentDataType, $1, 0, "");
+        if(strcmp(ctx->currentDataType, "string") == 0) {
+            StrView empty = viewOf("");
+            createVariable(ctx, ctx->currentDataType, $1, 0, &(strValue){ empty, NULL });
+            emitString(ctx, empty);
         } else {
-            createVariable(currentDataType, $1, 0, NULL);
+            createVariable(ctx, ctx->currentDataType, $1, 0, NULL);
+            emit(ctx, OP_PUSH_INT, 0);
         }
-        if(hasError) YYABORT;
-        free($1);
+        emitEffect(ctx, OP_DECL, $1, ctx->currentDataType[0]);
+        if(ctx->hasError) YYABORT;
     }
     | VARIABLE ASSIGNMENT {
         // Set the variable being declared BEFORE evaluating expression
-        currentVarBeingDeclared = strdup($1);
+        ctx->currentVarBeingDeclared = $1;
         
         // Check if we're trying to assign to string type with expression
-        if(strcmp(currentDataType, "string") == 0) {
-            yyerror("String expressions are not allowed. Cannot assign expression to string variable '%s' on line %d", 
-                    currentVarBeingDeclared, yylineno);
-            hasError = 1;
-            free(currentVarBeingDeclared);
-            currentVarBeingDeclared = NULL;
-            free($1);
+        if(strcmp(ctx->currentDataType, "string") == 0) {
+            yyerror(ctx, "String expressions are not allowed. Cannot assign expression to string variable '%s' on line %d", 
+                    symbolName(ctx, ctx->currentVarBeingDeclared), ctx->line);
+            ctx->hasError = 1;
+            ctx->currentVarBeingDeclared = NO_SYMBOL;
             YYABORT;
         }
     } expression {
         // Create variable with the expression value (only for non-string types)
-        if(!hasError) {
-            createVariable(currentDataType, $1, $4, NULL);
+        if(!ctx->hasError) {
+            createVariable(ctx, ctx->currentDataType, $1, $4, NULL);
+            emitEffect(ctx, OP_DECL, $1, ctx->currentDataType[0]);
         }
-        free(currentVarBeingDeclared);
-        currentVarBeingDeclared = NULL;
-        free($1);
-        if(hasError) YYABORT;
+        ctx->currentVarBeingDeclared = NO_SYMBOL;
+        if(ctx->hasError) YYABORT;
     }
     | VARIABLE ASSIGNMENT STRING '+' {
-        yyerror("String expressions are not allowed. Cannot use '+' operator with string variable '%s' on line %d", 
-                $1, yylineno);
-        hasError = 1;
-        free($1);
-        free($3);
+        yyerror(ctx, "String expressions are not allowed. Cannot use '+' operator with string variable '%s' on line %d", 
+                symbolName(ctx, $1), ctx->line);
+        ctx->hasError = 1;
         YYABORT;
     } STRING {
         // This action will never be reached due to YYABORT above
-        free($6);
     }
     | VARIABLE ASSIGNMENT STRING {
-        if(strcmp(currentDataType, "string") != 0) {
-            yyerror("Cannot assign string value to %s variable '%s' on line %d", 
-                    currentDataType, $1, yylineno);
-            hasError = 1;
-            free($1);
-            free($3);
+        if(strcmp(ctx->currentDataType, "string") != 0) {
+            yyerror(ctx, "Cannot assign string value to %s variable '%s' on line %d", 
+                    ctx->currentDataType, symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
             YYABORT;
         } else {
-            createVariable(currentDataType, $1, 0, $3);
-            if(hasError) {
-                free($1);
-                free($3);
-                YYABORT;
-            }
+            createVariable(ctx, ctx->currentDataType, $1, 0, &(strValue){ $3, NULL });
+            if(ctx->hasError) YYABORT;
+            emitString(ctx, $3);
+            emitEffect(ctx, OP_DECL, $1, 's');
         }
-        free($1);
-        free($3);
     }
     | VARIABLE ASSIGNMENT CHARACTER {
-        if(strcmp(currentDataType, "string") == 0) {
-            yyerror("Cannot assign character value to string variable '%s' on line %d", 
-                    $1, yylineno);
-            hasError = 1;
-            free($1);
+        if(strcmp(ctx->currentDataType, "string") == 0) {
+            yyerror(ctx, "Cannot assign character value to string variable '%s' on line %d", 
+                    symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
             YYABORT;
         } else {
-            createVariable(currentDataType, $1, (int)$3, NULL);
-            if(hasError) {
-                free($1);
-                YYABORT;
-            }
+            createVariable(ctx, ctx->currentDataType, $1, (int)$3, NULL);
+            if(ctx->hasError) YYABORT;
+            emit(ctx, OP_PUSH_INT, (int)$3);
+            emitEffect(ctx, OP_DECL, $1, ctx->currentDataType[0]);
         }
-        free($1);
     }
     | VARIABLE ASSIGNMENT VARIABLE {
         // Handle string to string assignment (copy value from another string variable)
-        if(strcmp(currentDataType, "string") == 0) {
-            vars *sourceVar = getVariable($3);
+        if(strcmp(ctx->currentDataType, "string") == 0) {
+            vars *sourceVar = getVariable(ctx, $3);
             if(!sourceVar) {
-                yyerror("Undefined variable '%s' on line %d", $3, yylineno);
-                hasError = 1;
-                free($1);
-                free($3);
+                yyerror(ctx, "Undefined variable '%s' on line %d", symbolName(ctx, $3), ctx->line);
+                ctx->hasError = 1;
                 YYABORT;
             } else if(sourceVar->data_type != 's') {
-                yyerror("Cannot assign non-string variable to string variable '%s' on line %d", $1, yylineno);
-                hasError = 1;
-                free($1);
-                free($3);
+                yyerror(ctx, "Cannot assign non-string variable to string variable '%s' on line %d", symbolName(ctx, $1), ctx->line);
+                ctx->hasError = 1;
                 YYABORT;
             } else {
-                createVariable(currentDataType, $1, 0, sourceVar->data.str_val);
-                if(hasError) {
-                    free($1);
-                    free($3);
-                    YYABORT;
-                }
+                strValue source = variableString(sourceVar);
+                createVariable(ctx, ctx->currentDataType, $1, 0, &source);
+                if(ctx->hasError) YYABORT;
+                emit(ctx, OP_LOAD, $3);
+                emitEffect(ctx, OP_DECL, $1, 's');
             }
         } else {
             // For non-string types, treat as expression
-            currentVarBeingDeclared = strdup($1);
-            int val = getVariableValue($3);
-            if(hasError) {
-                free(currentVarBeingDeclared);
-                currentVarBeingDeclared = NULL;
-                free($1);
-                free($3);
-                YYABORT;
-            }
-            createVariable(currentDataType, $1, val, NULL);
-            free(currentVarBeingDeclared);
-            currentVarBeingDeclared = NULL;
-            if(hasError) {
-                free($1);
-                free($3);
+            ctx->currentVarBeingDeclared = $1;
+            int val = getVariableValue(ctx, $3);
+            if(ctx->hasError) {
+                ctx->currentVarBeingDeclared = NO_SYMBOL;
                 YYABORT;
             }
+            createVariable(ctx, ctx->currentDataType, $1, val, NULL);
+            ctx->currentVarBeingDeclared = NO_SYMBOL;
+            if(ctx->hasError) YYABORT;
+            emit(ctx, OP_LOAD_INT, $3);
+            emitEffect(ctx, OP_DECL, $1, ctx->currentDataType[0]);
         }
-        free($1);
-        free($3);
     }
     ;
 
@@ -501,132 +596,136 @@ assignment_list:
 
 assignment:
     VARIABLE ASSIGNMENT expression {
-        vars *var = getVariable($1);
+        vars *var = getVariable(ctx, $1);
         if(var && var->data_type == 's') {
-            yyerror("String expressions are not allowed. Cannot assign expression to string variable '%s' on line %d", $1, yylineno);
-            hasError = 1;
+            yyerror(ctx, "String expressions are not allowed. Cannot assign expression to string variable '%s' on line %d", symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
         } else {
-            variableReAssignment($1, $3, NULL);
+            variableReAssignment(ctx, $1, $3, NULL);
+            emitEffect(ctx, OP_STORE, $1, 0);
         }
-        free($1);
     }
     | VARIABLE ASSIGNMENT STRING '+' {
-        vars *var = getVariable($1);
+        vars *var = getVariable(ctx, $1);
         if(!var) {
-            yyerror("Undefined variable '%s' on line %d", $1, yylineno);
+            yyerror(ctx, "Undefined variable '%s' on line %d", symbolName(ctx, $1), ctx->line);
         } else {
-            yyerror("String expressions are not allowed. Cannot use '+' operator with string variable '%s' on line %d", 
-                    $1, yylineno);
+            yyerror(ctx, "String expressions are not allowed. Cannot use '+' operator with string variable '%s' on line %d", 
+                    symbolName(ctx, $1), ctx->line);
         }
-        hasError = 1;
-        free($1);
-        free($3);
+        ctx->hasError = 1;
         YYABORT;
     } STRING {
         // This action will never be reached due to YYABORT above
-        free($6);
     }
     | VARIABLE ASSIGNMENT STRING {
-        vars *var = getVariable($1);
+        vars *var = getVariable(ctx, $1);
         if(!var) {
-            yyerror("Undefined variable '%s' on line %d", $1, yylineno);
-            hasError = 1;
-            free($1);
-            free($3);
+            yyerror(ctx, "Undefined variable '%s' on line %d", symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
             YYABORT;
         } else if(var->data_type != 's') {
-            yyerror("Cannot assign string value to non-string variable '%s' on line %d", $1, yylineno);
-            hasError = 1;
-            free($1);
-            free($3);
+            yyerror(ctx, "Cannot assign string value to non-string variable '%s' on line %d", symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
             YYABORT;
         } else {
-            variableReAssignment($1, 0, $3);
+            variableReAssignment(ctx, $1, 0, &(strValue){ $3, NULL });
+            emitString(ctx, $3);
+            emitEffect(ctx, OP_STORE, $1, 0);
         }
-        free($1);
-        free($3);
-        if(hasError) YYABORT;
+        if(ctx->hasError) YYABORT;
     }
     | VARIABLE ASSIGNMENT CHARACTER {
-        vars *var = getVariable($1);
+        vars *var = getVariable(ctx, $1);
         if(var && var->data_type == 's') {
-            yyerror("Cannot assign character value to string variable '%s' on line %d", $1, yylineno);
-            hasError = 1;
+            yyerror(ctx, "Cannot assign character value to string variable '%s' on line %d", symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
         } else {
-            variableReAssignment($1, (int)$3, NULL);
+            variableReAssignment(ctx, $1, (int)$3, NULL);
+            emit(ctx, OP_PUSH_INT, (int)$3);
+            emitEffect(ctx, OP_STORE, $1, 0);
         }
-        free($1);
     }
     | VARIABLE ASSIGNMENT VARIABLE {
-        vars *targetVar = getVariable($1);
-        vars *sourceVar = getVariable($3);
+        vars *targetVar = getVariable(ctx, $1);
+        vars *sourceVar = getVariable(ctx, $3);
         
         if(!targetVar) {
-            yyerror("Undefined variable '%s' on line %d", $1, yylineno);
-            hasError = 1;
+            yyerror(ctx, "Undefined variable '%s' on line %d", symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
         } else if(!sourceVar) {
-            yyerror("Undefined variable '%s' on line %d", $3, yylineno);
-            hasError = 1;
+            yyerror(ctx, "Undefined variable '%s' on line %d", symbolName(ctx, $3), ctx->line);
+            ctx->hasError = 1;
         } else if(targetVar->data_type == 's' && sourceVar->data_type == 's') {
             // String to string assignment is allowed
-            variableReAssignment($1, 0, sourceVar->data.str_val);
+            strValue source = variableString(sourceVar);
+            variableReAssignment(ctx, $1, 0, &source);
+            emit(ctx, OP_LOAD, $3);
+            emitEffect(ctx, OP_STORE, $1, 0);
         } else if(targetVar->data_type == 's' && sourceVar->data_type != 's') {
-            yyerror("Cannot assign non-string variable to string variable '%s' on line %d", $1, yylineno);
-            hasError = 1;
+            yyerror(ctx, "Cannot assign non-string variable to string variable '%s' on line %d", symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
         } else if(targetVar->data_type != 's' && sourceVar->data_type == 's') {
-            yyerror("Cannot assign string variable to non-string variable '%s' on line %d", $1, yylineno);
-            hasError = 1;
+            yyerror(ctx, "Cannot assign string variable to non-string variable '%s' on line %d", symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
         } else {
             // Non-string to non-string
-            variableReAssignment($1, sourceVar->data.val, NULL);
+            variableReAssignment(ctx, $1, sourceVar->data.val, NULL);
+            emit(ctx, OP_LOAD_INT, $3);
+            emitEffect(ctx, OP_STORE, $1, 0);
         }
-        free($1);
-        free($3);
     }
     ;
 
 expression:
     INTEGER { 
         $$ = $1; 
+        emit(ctx, OP_PUSH_INT, $1);
     }
     | CHARACTER { 
         $$ = (int)$1; 
+        emit(ctx, OP_PUSH_INT, (int)$1);
     }
     | VARIABLE { 
         // Check if this variable is being declared right now
-        if(currentVarBeingDeclared && strcmp($1, currentVarBeingDeclared) == 0) {
-            yyerror("Variable '%s' used in its own initialization on line %d", 
-                    $1, yylineno);
-            hasError = 1;
+        if($1 == ctx->currentVarBeingDeclared) {
+            yyerror(ctx, "Variable '%s' used in its own initialization on line %d", 
+                    symbolName(ctx, $1), ctx->line);
+            ctx->hasError = 1;
             $$ = 0;
         } else {
-            $$ = getVariableValue($1);
+            $$ = getVariableValue(ctx, $1);
         }
-        free($1);
+        emit(ctx, OP_LOAD_INT, $1);
     }
     | '(' expression ')' { 
         $$ = $2; 
     }
     | expression '+' expression { 
         $$ = $1 + $3; 
+        emit(ctx, OP_ADD, 0);
     }
     | expression '-' expression { 
         $$ = $1 - $3; 
+        emit(ctx, OP_SUB, 0);
     }
     | expression '*' expression { 
         $$ = $1 * $3; 
+        emit(ctx, OP_MUL, 0);
     }
     | expression '/' expression { 
         if($3 == 0){
-            yyerror("Division by zero on line %d", yylineno);
-            hasError = 1;
+            yyerror(ctx, "Division by zero on line %d", ctx->line);
+            ctx->hasError = 1;
             $$ = 0;
         } else {
             $$ = $1 / $3;
         }
+        emit(ctx, OP_DIV, 0);
     }
     | '-' expression %prec UMINUS { 
         $$ = -$2; 
+        emit(ctx, OP_NEG, 0);
     }
     | '+' expression %prec UMINUS { 
         $$ = $2; 
@@ -636,23 +735,229 @@ expression:
 %%
 
 
-int main(void) {
-    printf("Welcome to my Custom sPyC!\n");
-    int result = yyparse();
-    if (headVars) printVariableTable();
-    if (headErrList) printErrorTable();
-    if (headErrList) cleanupErrorTable();
-    if (headVars) cleanupVariableTable();
+// usage: a [script]                   interpret (stdin when no script is given)
+//        a --compile PROGRAM [script] interpret once and save the bytecode
+//        a --run PROGRAM              execute saved bytecode, no parsing
+//        a --lex-only [script]        scan only and print the token count
+void interpInit(Interp *ctx, FILE *out) {
+    memset(ctx, 0, sizeof(*ctx));
+    for (int i = 0; i < OUT_CHANNELS; i++) ctx->channel[i] = out;
+    ctx->line = 1;
+    ctx->currentVarBeingDeclared = NO_SYMBOL;
+    ctx->prog.lastLine = -1;
+}
+
+void interpFree(Interp *ctx) {
+    memFree(ctx->profLines);
+    ctx->profLines = NULL;
+    outFlush(ctx);
+    memFree(ctx->outBuf);
+    ctx->outBuf = NULL;
+    if (ctx->headErrList) cleanupErrorTable(ctx);
+    if (ctx->varTable) cleanupVariableTable(ctx);
+    cleanupSymbolNames(ctx);
+    arenaRelease(ctx);
+    cleanupProgram(ctx);
+    closeInput(ctx);
+}
+
+/*---------------------------------REPL-----------------------------------------------------*/
+// Reports errors recorded since 'shown' and returns the new tail
+static errorList* showNewErrors(Interp *ctx, errorList *shown) {
+    for (errorList *e = shown ? shown->next : ctx->headErrList; e; e = e->next) {
+        outPrintf(ctx, OUT_TABLES, "Line %d: %s", e->line_error, e->error_type);
+        if (e->error_type[0] == '\0' || e->error_type[strlen(e->error_type) - 1] != '\n')
+            outWrite(ctx, OUT_TABLES, "\n", 1);
+        shown = e;
+    }
+    return shown;
+}
+
+// Reads 'in' a line at a time and pushes its tokens into the parser, so each
+// statement runs as soon as its SEMI arrives and the work per line does not
+// grow with the session. Variables persist until the input ends; a statement
+// with an error is dropped and parsing restarts at the next token.
+int runRepl(Interp *ctx, FILE *in) {
+    yypstate *ps = yypstate_new();
+    if (!ps) return 1;
+
+    // STRING tokens point into their line, so lines stay alive until the
+    // statement that uses them is complete
+    char **held = NULL;
+    size_t heldCount = 0, heldCap = 0;
+
+    errorList *shown = NULL;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int lineNo = 0, status = YYPUSH_MORE, failed = 0;
+    int interactive = isatty(fileno(in));
+
+    if (interactive) {
+        outFlush(ctx);
+        fputs("> ", stderr);
+    }
+    while ((len = getline(&line, &cap, in)) != -1) {
+        lineNo++;
+        if (heldCount == heldCap) {
+            size_t newCap = heldCap ? heldCap * 2 : 16;
+            char **grown = memRealloc(MEM_LEXER, held, newCap * sizeof(char *));
+            if (!grown) {
+                failed = 1;
+                break;
+            }
+            held = grown;
+            heldCap = newCap;
+        }
+        char *text = memAlloc(MEM_LEXER, (size_t)len + 2);
+        if (!text || (memcpy(text, line, (size_t)len), !feedInput(ctx, text, (size_t)len, lineNo))) {
+            memFree(text);
+            failed = 1;
+            break;
+        }
+        held[heldCount++] = text;
+
+        YYSTYPE value;
+        int token;
+        while ((token = yylex(&value, ctx)) != 0) {
+            status = yypush_parse(ps, token, &value, ctx);
+            if (status != YYPUSH_MORE) {
+                // Aborted on an error: forget the statement, keep the variables
+                failed = 1;
+                yypstate_delete(ps);
+                ps = yypstate_new();
+                if (!ps) break;
+                ctx->hasError = 0;
+                ctx->currentVarBeingDeclared = NO_SYMBOL;
+                arenaReset(ctx);
+            } else if (token != SEMI) {
+                continue;
+            }
+            // Statement boundary: only the current line can still be referenced
+            for (size_t i = 0; i + 1 < heldCount; i++) memFree(held[i]);
+            held[0] = held[heldCount - 1];
+            heldCount = 1;
+        }
+        shown = showNewErrors(ctx, shown);
+        outFlush(ctx);
+        if (!ps) break;
+        if (interactive) fputs("> ", stderr);
+    }
+
+    // End of input finishes the last statement, if it is complete
+    if (ps && yypush_parse(ps, YYEOF, NULL, ctx) != 0) failed = 1;
+    showNewErrors(ctx, shown);
+
+    yypstate_delete(ps);
+    for (size_t i = 0; i < heldCount; i++) memFree(held[i]);
+    memFree(held);
+    free(line);
+    return failed;
+}
+
+// Runs the scanner over the open input without parsing and returns the token
+// count, so the lexer can be timed on its own
+long scanOnly(Interp *ctx) {
+    YYSTYPE value;
+    long tokens = 0;
+    int token;
+    while ((token = yylex(&value, ctx)) != 0) {
+        tokens++;
+        // Only DATA_TYPE copies land in the arena; drop them per statement
+        if (token == SEMI) arenaReset(ctx);
+    }
+    return tokens;
+}
+
+// Build with -DSPYC_NO_MAIN to link the interpreter into another driver (spyc-batch)
+#ifndef SPYC_NO_MAIN
+// With SPYC_STAGE_TIMES set, prints "stage <name> <seconds>" to stderr, the
+// format bench/stages.sh reads
+static uint64_t profileNow(void);
+
+static void reportStage(const char *stage, uint64_t started) {
+    if (getenv("SPYC_STAGE_TIMES"))
+        fprintf(stderr, "stage %s %.6f\n", stage, (profileNow() - started) / 1e9);
+}
+
+int main(int argc, char **argv) {
+    const char *script = NULL, *compileTo = NULL, *runFrom = NULL;
+    const char *saveTo = NULL, *loadFrom = NULL;
+    int repl = 0, trace = 1, profile = 0, lexOnly = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compile") == 0 && i + 1 < argc) compileTo = argv[++i];
+        else if (strcmp(argv[i], "--run") == 0 && i + 1 < argc) runFrom = argv[++i];
+        else if (strcmp(argv[i], "--repl") == 0) repl = 1;
+        else if (strcmp(argv[i], "--no-trace") == 0) trace = 0;
+        else if (strcmp(argv[i], "--profile") == 0) profile = 1;
+        else if (strcmp(argv[i], "--lex-only") == 0) lexOnly = 1;
+        else if (strcmp(argv[i], "--save-state") == 0 && i + 1 < argc) saveTo = argv[++i];
+        else if (strcmp(argv[i], "--load-state") == 0 && i + 1 < argc) loadFrom = argv[++i];
+        else script = argv[i];
+    }
+
+    memReportAtExit();
+    Interp interp;
+    Interp *ctx = &interp;
+    interpInit(ctx, stdout);
+    if (!trace) setChannel(ctx, OUT_TRACE, NULL);
+
+    int result;
+    // A program interns its symbols first, so its state is loaded after it
+    if (runFrom && !loadProgram(ctx, runFrom)) return 1;
+    if (loadFrom && !loadState(ctx, loadFrom)) return 1;
+    if (profile) profileStart(ctx);
+
+    // Everything but --run and --repl scans a script (stdin when none is named)
+    if (!runFrom && !repl && !openInput(ctx, script)) {
+        fprintf(stderr, "Could not read input %s\n", script ? script : "from stdin");
+        return 1;
+    }
+
+    if (runFrom) {
+        outPrintf(ctx, OUT_TABLES, "Welcome to my Custom sPyC!\n");
+        result = runProgram(ctx);
+    } else if (repl) {
+        outPrintf(ctx, OUT_TABLES, "Welcome to my Custom sPyC!\n");
+        result = runRepl(ctx, stdin);
+    } else if (lexOnly) {
+        uint64_t started = profileNow();
+        long tokens = scanOnly(ctx);
+        reportStage("lex", started);
+        outPrintf(ctx, OUT_TABLES, "Tokens: %ld\n", tokens);
+        result = 0;
+    } else {
+        ctx->compiling = compileTo != NULL;
+        outPrintf(ctx, OUT_TABLES, "Welcome to my Custom sPyC!\n");
+        uint64_t started = profileNow();
+        result = yyparse(ctx);
+        reportStage("parse_eval", started);
+        if (compileTo) {
+            if (result == 0 && !ctx->headErrList) result = !saveProgram(ctx, compileTo);
+            else fprintf(stderr, "Not writing %s: script has errors\n", compileTo);
+        }
+    }
+    if (saveTo) {
+        if (result == 0 && !ctx->headErrList) result = !saveState(ctx, saveTo);
+        else fprintf(stderr, "Not writing %s: script has errors\n", saveTo);
+    }
+
+    profileStop(ctx);
+    if (ctx->varCount) printVariableTable(ctx);
+    if (ctx->headErrList) printErrorTable(ctx);
+    if (profile) printProfile(ctx);
+    interpFree(ctx);
     return result;
 }
+#endif
 
 
 /*---------------------------------Error handling---------------------------------------------------*/
-void yyerror(const char *fmt, ...) {
+void yyerror(Interp *ctx, const char *fmt, ...) {
     if (fmt && strcmp(fmt, "syntax error") == 0)
         return;
 
-    hasError = 1;
+    ctx->hasError = 1;
 
     va_list args;
     va_start(args, fmt);
@@ -660,70 +965,112 @@ void yyerror(const char *fmt, ...) {
     char buffer[512];
     vsnprintf(buffer, sizeof(buffer), fmt, args);
     va_end(args);
-    errorList *currentError = calloc(1, sizeof(errorList));
+    errorList *currentError = memCalloc(MEM_DIAG, 1, sizeof(errorList));
     if(!currentError){
         fprintf(stderr, "Memory allocation failed for error node. Parser at fault.\n");
         return;
     }
 
-    currentError->line_error = yylineno;
-    currentError->error_type = strdup(buffer);
+    currentError->line_error = ctx->line;
+    currentError->error_type = memStrdup(MEM_DIAG, buffer);
     if(!currentError->error_type){
         fprintf(stderr, "Memory allocation failed for error message. Parser at fault.\n");
-        free(currentError);
+        memFree(currentError);
         return;
     }
     currentError->next = NULL;
 
-    if(!headErrList){
-        headErrList = tailErrList = currentError;
+    if(!ctx->headErrList){
+        ctx->headErrList = ctx->tailErrList = currentError;
     }else{
-        tailErrList->next = currentError;
-        tailErrList = currentError; 
+        ctx->tailErrList->next = currentError;
+        ctx->tailErrList = currentError; 
     }
 }
 
-void printErrorTable() {
-    errorList *curr = headErrList;
-    printf("=========== Error Table ============\n");
+void printErrorTable(Interp *ctx) {
+    errorList *curr = ctx->headErrList;
+    outPrintf(ctx, OUT_TABLES, "=========== Error Table ============\n");
     while (curr) {
-        printf("Line %d: %s", curr->line_error, curr->error_type);
+        outPrintf(ctx, OUT_TABLES, "Line %d: %s", curr->line_error, curr->error_type);
         if (strlen(curr->error_type) == 0 || curr->error_type[strlen(curr->error_type) - 1] != '\n')
-            printf("\n");
+            outWrite(ctx, OUT_TABLES, "\n", 1);
         curr = curr->next;
     }
-    printf("===================================\n");
+    outPrintf(ctx, OUT_TABLES, "===================================\n");
 }
 
 
 
-void cleanupErrorTable(){
-    while (headErrList) {
-        errorList *tmp = headErrList;
-        headErrList = headErrList->next;
-        free(tmp->error_type);
-        free(tmp);
+void cleanupErrorTable(Interp *ctx){
+    while (ctx->headErrList) {
+        errorList *tmp = ctx->headErrList;
+        ctx->headErrList = ctx->headErrList->next;
+        memFree(tmp->error_type);
+        memFree(tmp);
     }
-    headErrList = tailErrList = NULL;
+    ctx->headErrList = ctx->tailErrList = NULL;
+}
+
+
+/*--------------- Shared strings ----------------------------*/
+// Variable strings are immutable and reference counted: assigning one string
+// variable to another shares the text, and reassignment swaps in a new
+// string rather than editing the old one, so shared text is never copied.
+typedef struct sharedString {
+    int refs;
+    size_t len;
+    char text[];
+} sharedString;
+
+#define SHARED_STRING(text) ((sharedString *)((text) - offsetof(sharedString, text)))
+
+// New string holding a copy of 'str', with one reference
+char* stringNew(StrView str) {
+    sharedString *s = memAlloc(MEM_SYMTAB, sizeof(sharedString) + str.len + 1);
+    if (!s) {
+        fprintf(stderr, "Failed to allocate memory for string value\n");
+        exit(1);
+    }
+    s->refs = 1;
+    s->len = str.len;
+    memcpy(s->text, str.ptr, str.len);
+    s->text[str.len] = '\0';
+    return s->text;
 }
 
+char* stringRetain(char *text) {
+    if (text) SHARED_STRING(text)->refs++;
+    return text;
+}
+
+void stringRelease(char *text) {
+    if (text && --SHARED_STRING(text)->refs == 0) memFree(SHARED_STRING(text));
+}
+
+// View of a shared string without scanning for its terminator
+StrView stringView(const char *text) {
+    StrView view = { text, SHARED_STRING(text)->len };
+    return view;
+}
 
 /*--------------- Variable handling ----------------------------*/
-int getVariableValue(char *variableName){
-    if (isRecovering) return 0;
+int getVariableValue(Interp *ctx, int sym){
+    if (ctx->isRecovering) return 0;
     
-    vars *existing = getVariable(variableName);
+    const char *variableName = symbolName(ctx, sym);
+    vars *existing = getVariable(ctx, sym);
     
     if(!existing){
         // Variable doesn't exist at all - this is an error
-        yyerror("Undefined variable %s, on line %d.", variableName, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Undefined variable %s, on line %d.", variableName, ctx->line);
+        ctx->hasError = 1;
         return 0;
     }
     
     if(existing->data_type == 's'){
-        yyerror("Cannot perform arithmetic operations on variable %s: string literals, on line %d.", variableName, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Cannot perform arithmetic operations on variable %s: string literals, on line %d.", variableName, ctx->line);
+        ctx->hasError = 1;
         return 0;
     }
     
@@ -731,18 +1078,14 @@ int getVariableValue(char *variableName){
     return existing->data.val;
 }
 
-void cleanupVariableTable() {
-    vars *current = headVars;
-    vars *next;
-
-    while (current) {
-        next = current->next;
-        if (current->data_type == 's' && current->data.str_val) free(current->data.str_val);
-        free(current->id);
-        free(current);
-        current = next;
+void cleanupVariableTable(Interp *ctx) {
+    for (int i = 0; i < ctx->varCount; i++) {
+        releaseVarString(&ctx->varTable[i]);
+        ctx->symVars[ctx->varTable[i].sym] = 0;
     }
-    headVars = tailVars = NULL;
+    memFree(ctx->varTable);
+    ctx->varTable = NULL;
+    ctx->varCount = ctx->varCap = 0;
 }
 
 const char* typeName(char dt) {
@@ -750,65 +1093,93 @@ const char* typeName(char dt) {
 }
 
 
-vars* getVariable(char* variable) {
-    vars *current = headVars;
-    while (current) {
-        if (strcmp(current->id, variable) == 0) {
-            return current;
-        }
-        current = current->next;
+vars* getVariable(Interp *ctx, int sym) {
+    ctx->profPending.lookups++;
+    int slot = ctx->symVars[sym];
+    return slot ? &ctx->varTable[slot - 1] : NULL;
+}
+
+StrView varString(const vars *v) {
+    if (v->inlineLen == VAR_SHARED) return stringView(v->data.str_val);
+    StrView view = { v->data.inl, v->inlineLen };
+    return view;
+}
+
+strValue variableString(const vars *v) {
+    strValue value = { varString(v), v->inlineLen == VAR_SHARED ? v->data.str_val : NULL };
+    return value;
+}
+
+// Stores a string value into a record: shared strings gain a reference,
+// short ones are copied inline and only long literals are allocated.
+// Returns the number of bytes allocated.
+size_t setVarString(vars *v, const strValue *str) {
+    if (str->shared) {
+        v->data.str_val = stringRetain(str->shared);
+        v->inlineLen = VAR_SHARED;
+    } else if (str->text.len <= VAR_INLINE_MAX) {
+        memmove(v->data.inl, str->text.ptr, str->text.len);
+        v->data.inl[str->text.len] = '\0';
+        v->inlineLen = (unsigned char)str->text.len;
+    } else {
+        v->data.str_val = stringNew(str->text);
+        v->inlineLen = VAR_SHARED;
+        return sizeof(sharedString) + str->text.len + 1;
     }
-    return NULL;
+    return 0;
+}
+
+void releaseVarString(vars *v) {
+    if (v->data_type == 's' && v->inlineLen == VAR_SHARED) stringRelease(v->data.str_val);
 }
 
-void createVariable(char *DTYPE, char* variable, int val, char *str_val) {  
+void createVariable(Interp *ctx, const char *DTYPE, int sym, int val, const strValue *str_val) {  
+    const char *variable = symbolName(ctx, sym);
     if(isdigit(variable[0])){
-        yyerror("Variable %s can't start in INTEGER, in line %d.", variable, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Variable %s can't start in INTEGER, in line %d.", variable, ctx->line);
+        ctx->hasError = 1;
         return;
     }
 
-    vars *existing = getVariable(variable);
+    vars *existing = getVariable(ctx, sym);
 
     if (existing && DTYPE && strlen(DTYPE) > 0) {
-        yyerror("Variable '%s' is already declared with type '%s' on line %d", 
-                variable, typeName(existing->data_type), yylineno);
-        hasError = 1;
+        yyerror(ctx, "Variable '%s' is already declared with type '%s' on line %d", 
+                variable, typeName(existing->data_type), ctx->line);
+        ctx->hasError = 1;
         return;
     }
 
     if (existing && (!DTYPE || strlen(DTYPE) == 0)) {
-        variableReAssignment(variable, val, str_val);
+        variableReAssignment(ctx, sym, val, str_val);
         return;
     }
 
     if (!existing && (!DTYPE || strlen(DTYPE) == 0)) {
-        yyerror("Undefined variable '%s' on line %d", variable, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Undefined variable '%s' on line %d", variable, ctx->line);
+        ctx->hasError = 1;
         return;
     }
 
     if (strcmp(DTYPE, "int") == 0 && str_val != NULL) {
-        yyerror("Cannot assign string value to int variable '%s' on line %d", variable, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Cannot assign string value to int variable '%s' on line %d", variable, ctx->line);
+        ctx->hasError = 1;
         return;
     }
     if (strcmp(DTYPE, "char") == 0 && str_val != NULL) {
-        yyerror("Cannot assign string value to char variable '%s' on line %d", variable, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Cannot assign string value to char variable '%s' on line %d", variable, ctx->line);
+        ctx->hasError = 1;
         return;
     }
     if (strcmp(DTYPE, "string") == 0 && str_val == NULL) {
-        yyerror("Cannot assign non-string value to string variable '%s' on line %d", variable, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Cannot assign non-string value to string variable '%s' on line %d", variable, ctx->line);
+        ctx->hasError = 1;
         return;
     }
 
-    vars *newVar = calloc(1, sizeof(vars));
-    if (!newVar) {
-        fprintf(stderr, "Failed to allocate memory for variable '%s'\n", variable);
-        return;
-    }
+    // Filled in before the table grows, since 'str_val' may point into it
+    vars record = { .sym = sym };
+    vars *newVar = &record;
 
     if (strcmp(DTYPE, "int") == 0) {
         newVar->data_type = 'i';
@@ -818,97 +1189,1197 @@ void createVariable(char *DTYPE, char* variable, int val, char *str_val) {
         newVar->data.val = val;
     } else if (strcmp(DTYPE, "string") == 0) {
         newVar->data_type = 's';
-        // For strings, use provided value or empty string
-        if(str_val != NULL) {
-            newVar->data.str_val = strdup(str_val);
-        } else {
-            newVar->data.str_val = strdup("");
-        }
-        if (!newVar->data.str_val) {
-            fprintf(stderr, "Failed to allocate memory for string value\n");
-            free(newVar);
-            return;
-        }
+        ctx->profPending.heapBytes += setVarString(newVar, str_val);
     } else {
-        yyerror("Invalid data type '%s' for variable '%s'", DTYPE, variable);
-        free(newVar);
+        yyerror(ctx, "Invalid data type '%s' for variable '%s'", DTYPE, variable);
         return;
     }
 
-    newVar->id = strdup(variable);
-    if (!newVar->id) {
-        fprintf(stderr, "Failed to allocate memory for variable ID '%s'\n", variable);
-        if (newVar->data_type == 's' && newVar->data.str_val)
-            free(newVar->data.str_val);
-        free(newVar);
+    if (!appendVariable(ctx, &record)) {
+        fprintf(stderr, "Failed to allocate memory for variable '%s'\n", variable);
+        releaseVarString(newVar);
         return;
     }
 
-    newVar->next = NULL;
-
-    if (!headVars) {
-        headVars = tailVars = newVar;
-    } else {
-        tailVars->next = newVar;
-        tailVars = newVar;
-    }
+    if (ctx->channel[OUT_TRACE])
+        outPrintf(ctx, OUT_TRACE, "Variable '%s' successfully created on line %d.\n", variable, ctx->line);
+}
 
-    printf("Variable '%s' successfully created on line %d.\n", variable, yylineno);
+// Adds a filled-in record to the table and indexes it; 0 if out of memory
+int appendVariable(Interp *ctx, const vars *record) {
+    if (ctx->varCount == ctx->varCap) {
+        int newCap = ctx->varCap ? ctx->varCap * 2 : 256;
+        vars *table = memRealloc(MEM_SYMTAB, ctx->varTable, newCap * sizeof(vars));
+        if (!table) return 0;
+        ctx->varTable = table;
+        ctx->varCap = newCap;
+    }
+    ctx->varTable[ctx->varCount++] = *record;
+    ctx->profPending.heapBytes += sizeof(vars);
+    ctx->symVars[record->sym] = ctx->varCount;
+    return 1;
 }
 
-void variableReAssignment(char* variable, int val, char *str_val){
-    vars *existing = getVariable(variable);
+void variableReAssignment(Interp *ctx, int sym, int val, const strValue *str_val){
+    const char *variable = symbolName(ctx, sym);
+    vars *existing = getVariable(ctx, sym);
 
     if(!existing){
-        yyerror("Undefined variable %s on line %d.", variable, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Undefined variable %s on line %d.", variable, ctx->line);
+        ctx->hasError = 1;
         return;
     }
 
     if (existing->data_type == 'i' && str_val != NULL) {
-        yyerror("Cannot assign string value to int variable '%s' on line %d", variable, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Cannot assign string value to int variable '%s' on line %d", variable, ctx->line);
+        ctx->hasError = 1;
         return;
     }
     if (existing->data_type == 'c' && str_val != NULL) {
-        yyerror("Cannot assign string value to char variable '%s' on line %d", variable, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Cannot assign string value to char variable '%s' on line %d", variable, ctx->line);
+        ctx->hasError = 1;
         return;
     }
     if (existing->data_type == 's' && str_val == NULL) {
-        yyerror("Cannot assign non-string value to string variable '%s' on line %d", variable, yylineno);
-        hasError = 1;
+        yyerror(ctx, "Cannot assign non-string value to string variable '%s' on line %d", variable, ctx->line);
+        ctx->hasError = 1;
         return;
     }
 
     if(existing->data_type == 'i' || existing->data_type == 'c'){
         existing->data.val = val;
     } else {
-        char *new_str = strdup(str_val ? str_val : "");
-        if(!new_str){
-            yyerror("Failed to allocate memory for str value on line %d", yylineno);
-            hasError = 1;
-            return;
-        }
-        free(existing->data.str_val);
-        existing->data.str_val = new_str;
+        // Set the new value before releasing the old one: they may be the same
+        vars old = *existing;
+        ctx->profPending.heapBytes += setVarString(existing, str_val);
+        releaseVarString(&old);
     }
     
-    printf("Variable '%s' updated successfully on line %d.\n", variable, yylineno);
+    if (ctx->channel[OUT_TRACE])
+        outPrintf(ctx, OUT_TRACE, "Variable '%s' updated successfully on line %d.\n", variable, ctx->line);
 }
 
 
-void printVariableTable() {
-    printf("\n=== Variable Table ===\n");
-    vars *curr = headVars;
-    while (curr) {
-        printf("Variable: %s, Type: %s", curr->id, typeName(curr->data_type));
+StrView viewOf(const char *str) {
+    StrView view = { str, strlen(str) };
+    return view;
+}
+
+
+/*--------------- Display operands ----------------------------*/
+// Numeric value of an operand, read the way atoi() reads its printed text:
+// strings and chars only count when they start with digits.
+int dispNumber(const Disp *d) {
+    if (d->type == 3) return d->num;
+    if (d->type == 2) return isdigit((unsigned char)d->ch) ? d->ch - '0' : 0;
+    if (d->type != 1) return 0;
+
+    // Walk the text piece by piece so a concatenation needs no flattening
+    const ropePiece *piece = d->pieces;
+    StrView text = piece ? piece->text : d->str;
+    size_t i = 0;
+    int state = 0;   // 0 = leading blanks, 1 = after sign, 2 = digits
+    int sign = 1, val = 0;
+    for (;;) {
+        if (i == text.len) {
+            if (!piece || !piece->next) break;
+            piece = piece->next;
+            text = piece->text;
+            i = 0;
+            continue;
+        }
+        char c = text.ptr[i++];
+        if (state == 0 && isspace((unsigned char)c)) continue;
+        if (state == 0 && (c == '-' || c == '+')) {
+            if (c == '-') sign = -1;
+            state = 1;
+            continue;
+        }
+        if (!isdigit((unsigned char)c)) break;
+        val = val * 10 + (c - '0');
+        state = 2;
+    }
+    return sign * val;
+}
+
+// Printed form of a non-string operand into 'buf', returns its length.
+// An unset char prints as nothing, the way its one-char C string used to.
+static size_t formatScalar(const Disp *d, char *buf) {
+    if (d->type == 2) {
+        buf[0] = d->ch;
+        return d->ch != '\0';
+    }
+    return (size_t)sprintf(buf, "%d", d->num);
+}
+
+// Turns a single-valued operand into a one-piece rope
+static void makeRope(Interp *ctx, Disp *d) {
+    if (d->pieces) return;
+    ropePiece *piece = arenaAlloc(ctx, sizeof(ropePiece));
+    piece->next = NULL;
+    if (d->type == 1) {
+        piece->text = d->str;
+    } else {
+        piece->text.ptr = piece->scratch;
+        piece->text.len = formatScalar(d, piece->scratch);
+    }
+    d->pieces = d->last = piece;
+}
+
+// Appends right's pieces to left's in O(1) and moves the result into 'out';
+// both operands are consumed. Pieces live in the statement arena
+void concatDisp(Interp *ctx, Disp *out, Disp *left, Disp *right) {
+    makeRope(ctx, left);
+    makeRope(ctx, right);
+    left->last->next = right->pieces;
+    out->type = 1;
+    out->shared = NULL;
+    out->pieces = left->pieces;
+    out->last = right->last;
+}
+
+// Writes the printed form of an operand, walking rope pieces in order
+void printDisp(Interp *ctx, const Disp *d) {
+    if (d->type == 1 && d->pieces) {
+        for (const ropePiece *p = d->pieces; p; p = p->next)
+            outWrite(ctx, OUT_DISPLAY, p->text.ptr, p->text.len);
+    } else if (d->type == 1) {
+        outWrite(ctx, OUT_DISPLAY, d->str.ptr, d->str.len);
+    } else if (d->type == 2 || d->type == 3) {
+        char buf[12];
+        outWrite(ctx, OUT_DISPLAY, buf, formatScalar(d, buf));
+    }
+}
+
+void printVariableTable(Interp *ctx) {
+    outPrintf(ctx, OUT_TABLES, "\n=== Variable Table ===\n");
+    for (int i = 0; i < ctx->varCount; i++) {
+        const vars *curr = &ctx->varTable[i];
+        outPrintf(ctx, OUT_TABLES, "Variable: %s, Type: %s", symbolName(ctx, curr->sym), typeName(curr->data_type));
         if (curr->data_type == 's') {
-            printf(", Value: \"%s\"\n", curr->data.str_val);
+            outPrintf(ctx, OUT_TABLES, ", Value: \"%s\"\n", curr->inlineLen == VAR_SHARED ? curr->data.str_val : curr->data.inl);
         } else {
-            printf(", Value: %d\n", curr->data.val);
+            outPrintf(ctx, OUT_TABLES, ", Value: %d\n", curr->data.val);
         }
-        curr = curr->next;
     }
-    printf("======================\n\n");
-}
\ No newline at end of file
+    outPrintf(ctx, OUT_TABLES, "======================\n\n");
+}
+
+/*------------------------------ Profiler ----------------------------------*/
+// --profile charges everything since the previous statement boundary (time,
+// lookups, allocation, output) to the line the finished statement ends on.
+// The bytecode VM treats each declaration, store and display as a boundary.
+// Heap(B) counts bytes that outlive the statement: variable table slots and
+// shared copies of long strings. Arena(B) counts bump allocations from the
+// statement arena (ropes, parse temporaries), which are reset in one step at
+// the statement's end rather than freed one by one.
+#define PROFILE_TOP 20
+
+static uint64_t profileNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void profileStart(Interp *ctx) {
+    ctx->profiling = 1;
+    memset(&ctx->profPending, 0, sizeof(ctx->profPending));
+    ctx->profMark = profileNow();
+}
+
+void profileStatement(Interp *ctx) {
+    int line = ctx->line > 0 ? ctx->line : 0;
+    if (line >= ctx->profLineCap) {
+        int newCap = ctx->profLineCap ? ctx->profLineCap : 1024;
+        while (newCap <= line) newCap *= 2;
+        lineProfile *lines = memRealloc(MEM_DIAG, ctx->profLines, newCap * sizeof(lineProfile));
+        if (!lines) return;   // drops this sample; the counters keep accumulating
+        memset(lines + ctx->profLineCap, 0, (newCap - ctx->profLineCap) * sizeof(lineProfile));
+        ctx->profLines = lines;
+        ctx->profLineCap = newCap;
+    }
+
+    uint64_t now = profileNow();
+    lineProfile *entry = &ctx->profLines[line];
+    entry->runs++;
+    entry->nanos += now - ctx->profMark;
+    entry->lookups += ctx->profPending.lookups;
+    entry->heapBytes += ctx->profPending.heapBytes;
+    entry->arenaBytes += ctx->profPending.arenaBytes;
+    entry->outBytes += ctx->profPending.outBytes;
+    memset(&ctx->profPending, 0, sizeof(ctx->profPending));
+    ctx->profMark = now;
+}
+
+typedef struct profileRow {
+    int line;
+    const lineProfile *cost;
+} profileRow;
+
+static int compareLineCost(const void *a, const void *b) {
+    const profileRow *x = a, *y = b;
+    if (x->cost->nanos != y->cost->nanos) return x->cost->nanos < y->cost->nanos ? 1 : -1;
+    return x->line - y->line;
+}
+
+// Ends profiling, charging whatever ran after the last complete statement
+// (e.g. one that failed) to the current line
+void profileStop(Interp *ctx) {
+    if (!ctx->profiling) return;
+    if (ctx->profPending.lookups || ctx->profPending.heapBytes || ctx->profPending.arenaBytes
+        || ctx->profPending.outBytes)
+        profileStatement(ctx);
+    ctx->profiling = 0;
+}
+
+// Hottest lines by wall time, then totals over every line
+void printProfile(Interp *ctx) {
+    profileRow *order = memAlloc(MEM_DIAG, (ctx->profLineCap ? ctx->profLineCap : 1) * sizeof(profileRow));
+    if (!order) return;
+    int used = 0;
+    lineProfile total = { 0 };
+    for (int i = 0; i < ctx->profLineCap; i++) {
+        const lineProfile *e = &ctx->profLines[i];
+        if (!e->runs) continue;
+        order[used].line = i;
+        order[used++].cost = e;
+        total.runs += e->runs;
+        total.nanos += e->nanos;
+        total.lookups += e->lookups;
+        total.heapBytes += e->heapBytes;
+        total.arenaBytes += e->arenaBytes;
+        total.outBytes += e->outBytes;
+    }
+    qsort(order, used, sizeof(profileRow), compareLineCost);
+
+    outPrintf(ctx, OUT_TABLES, "=============== Profile (hottest lines) ===============\n");
+    outPrintf(ctx, OUT_TABLES, "%8s %8s %12s %10s %12s %12s %12s\n",
+              "Line", "Runs", "Time(us)", "Lookups", "Heap(B)", "Arena(B)", "Output(B)");
+    for (int i = 0; i < used && i < PROFILE_TOP; i++) {
+        const lineProfile *e = order[i].cost;
+        outPrintf(ctx, OUT_TABLES, "%8d %8llu %12.1f %10llu %12llu %12llu %12llu\n", order[i].line,
+                  (unsigned long long)e->runs, e->nanos / 1000.0, (unsigned long long)e->lookups,
+                  (unsigned long long)e->heapBytes, (unsigned long long)e->arenaBytes,
+                  (unsigned long long)e->outBytes);
+    }
+    outPrintf(ctx, OUT_TABLES, "%8s %8llu %12.1f %10llu %12llu %12llu %12llu\n", "total",
+              (unsigned long long)total.runs, total.nanos / 1000.0, (unsigned long long)total.lookups,
+              (unsigned long long)total.heapBytes, (unsigned long long)total.arenaBytes,
+              (unsigned long long)total.outBytes);
+    outPrintf(ctx, OUT_TABLES, "=======================================================\n\n");
+    memFree(order);
+}
+
+/*------------------------------ Output sink -------------------------------*/
+// One buffer per context collects output for the stream it last wrote to.
+// Writing to a different stream flushes it first, so channels sharing a
+// stream keep their relative order.
+#define OUT_BUFFER_SIZE (1 << 16)
+
+void outFlush(Interp *ctx) {
+    if (ctx->outLen) fwrite(ctx->outBuf, 1, ctx->outLen, ctx->outDest);
+    ctx->outLen = 0;
+    if (ctx->outDest) fflush(ctx->outDest);
+}
+
+void setChannel(Interp *ctx, int channel, FILE *dest) {
+    outFlush(ctx);
+    ctx->channel[channel] = dest;
+}
+
+// Makes room for 'len' more bytes going to 'dest'; 0 if they should bypass the buffer
+static int outReserve(Interp *ctx, FILE *dest, size_t len) {
+    if (ctx->outDest != dest) {
+        outFlush(ctx);
+        ctx->outDest = dest;
+    }
+    if (!ctx->outBuf && !(ctx->outBuf = memAlloc(MEM_OUTPUT, OUT_BUFFER_SIZE))) return 0;
+    if (ctx->outLen + len > OUT_BUFFER_SIZE) {
+        fwrite(ctx->outBuf, 1, ctx->outLen, dest);
+        ctx->outLen = 0;
+    }
+    return len < OUT_BUFFER_SIZE;
+}
+
+void outWrite(Interp *ctx, int channel, const char *text, size_t len) {
+    FILE *dest = ctx->channel[channel];
+    if (!dest) return;
+    ctx->profPending.outBytes += len;
+    if (!outReserve(ctx, dest, len)) {
+        fwrite(text, 1, len, dest);
+        return;
+    }
+    memcpy(ctx->outBuf + ctx->outLen, text, len);
+    ctx->outLen += len;
+}
+
+void outPrintf(Interp *ctx, int channel, const char *fmt, ...) {
+    FILE *dest = ctx->channel[channel];
+    if (!dest) return;
+
+    va_list args;
+    if (outReserve(ctx, dest, 0)) {
+        // Format straight into the buffer; if it did not fit, flush and retry once
+        for (int attempt = 0; attempt < 2; attempt++) {
+            size_t room = OUT_BUFFER_SIZE - ctx->outLen;
+            va_start(args, fmt);
+            int n = vsnprintf(ctx->outBuf + ctx->outLen, room, fmt, args);
+            va_end(args);
+            if (n < 0) return;
+            if ((size_t)n < room) {
+                ctx->outLen += (size_t)n;
+                ctx->profPending.outBytes += (size_t)n;
+                return;
+            }
+            fwrite(ctx->outBuf, 1, ctx->outLen, dest);
+            ctx->outLen = 0;
+        }
+    }
+    // Longer than the whole buffer
+    va_start(args, fmt);
+    int n = vfprintf(dest, fmt, args);
+    va_end(args);
+    if (n > 0) ctx->profPending.outBytes += (size_t)n;
+}
+
+
+/*--------------- Symbol names ----------------------------*/
+// Every distinct identifier is stored once and numbered in order of first
+// appearance; the lexer hands the parser that number instead of a copy.
+#define NAME_BLOCK_SIZE 65536
+
+typedef struct nameBlock{
+    struct nameBlock *next;
+    size_t used;
+    size_t size;
+    char text[];
+} nameBlock;
+
+// FNV-1a over the identifier bytes
+static unsigned long hashName(const char *text, size_t len) {
+    unsigned long h = 2166136261UL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)text[i];
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+// Linear probing: returns the slot holding the name or the empty slot where it belongs
+static int* findNameSlot(Interp *ctx, const char *text, size_t len) {
+    size_t mask = ctx->symIndexCap - 1;
+    size_t i = hashName(text, len) & mask;
+    while (ctx->symIndex[i]) {
+        const char *name = ctx->symNames[ctx->symIndex[i] - 1];
+        if (strncmp(name, text, len) == 0 && name[len] == '\0') break;
+        i = (i + 1) & mask;
+    }
+    return &ctx->symIndex[i];
+}
+
+static int growNameIndex(Interp *ctx) {
+    int *oldIndex = ctx->symIndex;
+    size_t oldCap = ctx->symIndexCap;
+    size_t newCap = oldCap ? oldCap * 2 : 256;
+
+    int *newIndex = memCalloc(MEM_SYMTAB, newCap, sizeof(int));
+    if (!newIndex) return 0;
+
+    ctx->symIndex = newIndex;
+    ctx->symIndexCap = newCap;
+    for (size_t i = 0; i < oldCap; i++) {
+        if (oldIndex[i]) {
+            const char *name = ctx->symNames[oldIndex[i] - 1];
+            *findNameSlot(ctx, name, strlen(name)) = oldIndex[i];
+        }
+    }
+    memFree(oldIndex);
+    return 1;
+}
+
+static const char* storeName(Interp *ctx, const char *text, size_t len) {
+    if (!ctx->nameBlocks || ctx->nameBlocks->size - ctx->nameBlocks->used < len + 1) {
+        size_t size = len + 1 > NAME_BLOCK_SIZE ? len + 1 : NAME_BLOCK_SIZE;
+        nameBlock *block = memAlloc(MEM_SYMTAB, sizeof(nameBlock) + size);
+        if (!block) return NULL;
+        block->next = ctx->nameBlocks;
+        block->used = 0;
+        block->size = size;
+        ctx->nameBlocks = block;
+    }
+    char *name = ctx->nameBlocks->text + ctx->nameBlocks->used;
+    memcpy(name, text, len);
+    name[len] = '\0';
+    ctx->nameBlocks->used += len + 1;
+    return name;
+}
+
+int internName(Interp *ctx, const char *text, size_t len) {
+    ctx->profPending.lookups++;
+    // Keep the load factor at or below 1/2 so probe chains stay short
+    if ((size_t)(ctx->symCount + 1) * 2 > ctx->symIndexCap && !growNameIndex(ctx)) {
+        fprintf(stderr, "Failed to grow symbol name index. Parser at fault.\n");
+        exit(1);
+    }
+
+    int *slot = findNameSlot(ctx, text, len);
+    if (*slot) return *slot - 1;
+
+    if (ctx->symCount == ctx->symCap) {
+        int newCap = ctx->symCap ? ctx->symCap * 2 : 256;
+        const char **names = memRealloc(MEM_SYMTAB, ctx->symNames, newCap * sizeof(char*));
+        if (names) ctx->symNames = names;
+        int *byID = names ? memRealloc(MEM_SYMTAB, ctx->symVars, newCap * sizeof(int)) : NULL;
+        if (!byID) {
+            fprintf(stderr, "Failed to grow symbol name table. Parser at fault.\n");
+            exit(1);
+        }
+        memset(byID + ctx->symCap, 0, (newCap - ctx->symCap) * sizeof(int));
+        ctx->symVars = byID;
+        ctx->symCap = newCap;
+    }
+
+    const char *name = storeName(ctx, text, len);
+    if (!name) {
+        fprintf(stderr, "Failed to allocate memory for identifier. Parser at fault.\n");
+        exit(1);
+    }
+    ctx->symNames[ctx->symCount] = name;
+    *slot = ctx->symCount + 1;
+    return ctx->symCount++;
+}
+
+const char* symbolName(Interp *ctx, int sym) {
+    return ctx->symNames[sym];
+}
+
+void cleanupSymbolNames(Interp *ctx) {
+    while (ctx->nameBlocks) {
+        nameBlock *tmp = ctx->nameBlocks;
+        ctx->nameBlocks = ctx->nameBlocks->next;
+        memFree(tmp);
+    }
+    memFree(ctx->symNames);
+    memFree(ctx->symVars);
+    memFree(ctx->symIndex);
+    ctx->symNames = NULL;
+    ctx->symVars = NULL;
+    ctx->symIndex = NULL;
+    ctx->symCount = ctx->symCap = 0;
+    ctx->symIndexCap = 0;
+}
+
+
+/*--------------- Statement arena ----------------------------*/
+// Bump allocator for everything that dies with the statement being parsed:
+// keyword text from the lexer, display rope pieces. Reset after each
+// statement; chunks are kept and reused, so steady state does no malloc.
+#define ARENA_CHUNK_SIZE 65536
+#define ARENA_ALIGN 16
+
+typedef struct arenaChunk{
+    struct arenaChunk *next;
+    size_t used;
+    size_t size;
+    _Alignas(ARENA_ALIGN) char data[];
+} arenaChunk;
+
+void* arenaAlloc(Interp *ctx, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ctx->profPending.arenaBytes += size;
+
+    while (ctx->arenaCur && ctx->arenaCur->size - ctx->arenaCur->used < size) {
+        if (!ctx->arenaCur->next) break;
+        ctx->arenaCur = ctx->arenaCur->next;
+        ctx->arenaCur->used = 0;
+    }
+
+    if (!ctx->arenaCur || ctx->arenaCur->size - ctx->arenaCur->used < size) {
+        size_t chunkSize = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        arenaChunk *chunk = memAlloc(MEM_AST, sizeof(arenaChunk) + chunkSize);
+        if (!chunk) {
+            fprintf(stderr, "Failed to allocate statement arena. Parser at fault.\n");
+            exit(1);
+        }
+        chunk->next = NULL;
+        chunk->used = 0;
+        chunk->size = chunkSize;
+        if (ctx->arenaCur) ctx->arenaCur->next = chunk;
+        else ctx->arenaHead = chunk;
+        ctx->arenaCur = chunk;
+    }
+
+    void *mem = ctx->arenaCur->data + ctx->arenaCur->used;
+    ctx->arenaCur->used += size;
+    return mem;
+}
+
+char* arenaCopy(Interp *ctx, const char *text, size_t len) {
+    char *copy = arenaAlloc(ctx, len + 1);
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void arenaReset(Interp *ctx) {
+    ctx->arenaCur = ctx->arenaHead;
+    if (ctx->arenaCur) ctx->arenaCur->used = 0;
+}
+
+void arenaRelease(Interp *ctx) {
+    while (ctx->arenaHead) {
+        arenaChunk *tmp = ctx->arenaHead;
+        ctx->arenaHead = ctx->arenaHead->next;
+        memFree(tmp);
+    }
+    ctx->arenaCur = NULL;
+}
+
+
+/*--------------- Bytecode ----------------------------*/
+// With --compile, every action that evaluates something also appends the
+// equivalent stack-machine instructions. Scripts are straight-line code, so
+// a program compiled from an error-free run replays to the same result;
+// --run executes it without lexing or parsing the source again.
+//
+// Words are 32-bit: an opcode followed by its operands (see opArity).
+// File layout, all fields native-endian uint32:
+//   "SPYC" version maxDepth ctx->symCount strCount codeLen
+//   ctx->symCount x (len, bytes)   strCount x (len, bytes)   codeLen x word
+#define PROGRAM_MAGIC 0x43595053u   // "SPYC"
+#define PROGRAM_VERSION 1u
+
+static const int opArity[OP_COUNT] = {
+    [OP_LINE] = 1, [OP_PUSH_INT] = 1, [OP_PUSH_CHAR] = 1, [OP_PUSH_STR] = 1,
+    [OP_LOAD] = 1, [OP_LOAD_INT] = 1, [OP_DECL] = 2, [OP_STORE] = 1,
+};
+
+// Change in stack depth caused by each opcode
+static const int opEffect[OP_COUNT] = {
+    [OP_PUSH_INT] = 1, [OP_PUSH_CHAR] = 1, [OP_PUSH_STR] = 1, [OP_LOAD] = 1, [OP_LOAD_INT] = 1,
+    [OP_ADD] = -1, [OP_SUB] = -1, [OP_MUL] = -1, [OP_DIV] = -1,
+    [OP_DADD] = -1, [OP_DSUB] = -1, [OP_DMUL] = -1, [OP_DDIV] = -1,
+    [OP_DECL] = -1, [OP_STORE] = -1, [OP_DISPLAY] = -1,
+};
+
+static void emitWord(Interp *ctx, uint32_t word) {
+    if (ctx->prog.codeLen == ctx->prog.codeCap) {
+        size_t newCap = ctx->prog.codeCap ? ctx->prog.codeCap * 2 : 4096;
+        uint32_t *code = memRealloc(MEM_CODEGEN, ctx->prog.code, newCap * sizeof(uint32_t));
+        if (!code) {
+            fprintf(stderr, "Failed to grow bytecode buffer. Compiler at fault.\n");
+            exit(1);
+        }
+        ctx->prog.code = code;
+        ctx->prog.codeCap = newCap;
+    }
+    ctx->prog.code[ctx->prog.codeLen++] = word;
+}
+
+static void emitOp(Interp *ctx, int op) {
+    emitWord(ctx, (uint32_t)op);
+    ctx->prog.depth += opEffect[op];
+    if (ctx->prog.depth > ctx->prog.maxDepth) ctx->prog.maxDepth = ctx->prog.depth;
+}
+
+// Folds 'op' into the literal operands just emitted for it, so a saved
+// program never redoes literal-only arithmetic. Division by a constant zero
+// is left in place for the run-time check. Returns 1 if nothing is emitted.
+static int foldConstant(Interp *ctx, int op) {
+    program *prog = &ctx->prog;
+    if (op == OP_NEG || op == OP_DNEG) {
+        if (prog->constRun < 1) return 0;
+        int32_t value = (int32_t)prog->code[prog->codeLen - 1];
+        if (value == INT32_MIN) return 0;
+        prog->code[prog->codeLen - 1] = (uint32_t)-value;
+        return 1;
+    }
+    if (op < OP_ADD || op > OP_DDIV || op == OP_NEG || prog->constRun < 2) return 0;
+
+    int32_t a = (int32_t)prog->code[prog->codeLen - 3];
+    int32_t b = (int32_t)prog->code[prog->codeLen - 1];
+    int64_t result;
+    switch (op) {
+    case OP_ADD: case OP_DADD: result = (int64_t)a + b; break;
+    case OP_SUB: case OP_DSUB: result = (int64_t)a - b; break;
+    case OP_MUL: case OP_DMUL: result = (int64_t)a * b; break;
+    default:
+        if (b == 0) return 0;
+        result = (int64_t)a / b;
+        break;
+    }
+    // Overflow stays a run-time matter too
+    if (result < INT32_MIN || result > INT32_MAX) return 0;
+
+    prog->code[prog->codeLen - 3] = (uint32_t)(int32_t)result;
+    prog->codeLen -= 2;
+    prog->depth--;
+    prog->constRun--;
+    return 1;
+}
+
+void emit(Interp *ctx, int op, int operand) {
+    if (!ctx->compiling) return;
+    if (foldConstant(ctx, op)) return;
+    emitOp(ctx, op);
+    if (opArity[op] > 0) emitWord(ctx, (uint32_t)operand);
+    ctx->prog.constRun = op == OP_PUSH_INT ? ctx->prog.constRun + 1 : 0;
+}
+
+// Statement-level effects record the source line their messages report
+void emitEffect(Interp *ctx, int op, int sym, int dataType) {
+    if (!ctx->compiling) return;
+    if (ctx->line != ctx->prog.lastLine) {
+        emitOp(ctx, OP_LINE);
+        emitWord(ctx, (uint32_t)ctx->line);
+        ctx->prog.lastLine = ctx->line;
+    }
+    emitOp(ctx, op);
+    if (opArity[op] > 0) emitWord(ctx, (uint32_t)sym);
+    if (opArity[op] > 1) emitWord(ctx, (uint32_t)dataType);
+    ctx->prog.constRun = 0;
+}
+
+void emitString(Interp *ctx, StrView str) {
+    if (!ctx->compiling) return;
+    if (ctx->prog.strCount == ctx->prog.strCap) {
+        size_t newCap = ctx->prog.strCap ? ctx->prog.strCap * 2 : 256;
+        StrView *strings = memRealloc(MEM_CODEGEN, ctx->prog.strings, newCap * sizeof(StrView));
+        if (!strings) {
+            fprintf(stderr, "Failed to grow string pool. Compiler at fault.\n");
+            exit(1);
+        }
+        ctx->prog.strings = strings;
+        ctx->prog.strCap = newCap;
+    }
+    ctx->prog.strings[ctx->prog.strCount] = str;
+    emit(ctx, OP_PUSH_STR, (int)ctx->prog.strCount++);
+}
+
+static int writeWord(FILE *out, uint32_t word) {
+    return fwrite(&word, sizeof(word), 1, out) == 1;
+}
+
+static int writeBytes(FILE *out, const char *text, size_t len) {
+    return writeWord(out, (uint32_t)len) && fwrite(text, 1, len, out) == len;
+}
+
+int saveProgram(Interp *ctx, const char *path) {
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        fprintf(stderr, "Could not create %s\n", path);
+        return 0;
+    }
+    emitOp(ctx, OP_HALT);
+
+    int ok = writeWord(out, PROGRAM_MAGIC) && writeWord(out, PROGRAM_VERSION)
+          && writeWord(out, (uint32_t)ctx->prog.maxDepth) && writeWord(out, (uint32_t)ctx->symCount)
+          && writeWord(out, (uint32_t)ctx->prog.strCount) && writeWord(out, (uint32_t)ctx->prog.codeLen);
+    for (int i = 0; ok && i < ctx->symCount; i++)
+        ok = writeBytes(out, ctx->symNames[i], strlen(ctx->symNames[i]));
+    for (size_t i = 0; ok && i < ctx->prog.strCount; i++)
+        ok = writeBytes(out, ctx->prog.strings[i].ptr, ctx->prog.strings[i].len);
+    ok = ok && fwrite(ctx->prog.code, sizeof(uint32_t), ctx->prog.codeLen, out) == ctx->prog.codeLen;
+
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "Failed to write %s\n", path);
+    return ok;
+}
+
+static int readWord(const char **p, const char *end, uint32_t *word) {
+    if ((size_t)(end - *p) < sizeof(uint32_t)) return 0;
+    memcpy(word, *p, sizeof(uint32_t));
+    *p += sizeof(uint32_t);
+    return 1;
+}
+
+static int readBytes(const char **p, const char *end, StrView *text) {
+    uint32_t len;
+    if (!readWord(p, end, &len) || (size_t)(end - *p) < len) return 0;
+    text->ptr = *p;
+    text->len = len;
+    *p += len;
+    return 1;
+}
+
+// Run-time types a stack slot may hold, as a set
+enum { SLOT_INT = 1, SLOT_CHAR = 2, SLOT_STR = 4, SLOT_ROPE = 8 };
+// A variable the program does not declare itself, e.g. one from --load-state
+#define SLOT_LOADED (SLOT_INT | SLOT_CHAR | SLOT_STR)
+
+// Checks opcodes, operands, stack depth and operand types once so the
+// dispatch loop can trust them. Every slot of the abstract stack records the
+// types it may hold; a variable declared earlier in the program loads with
+// its declared type. The dispatch loop reads the value union without looking
+// at the tag everywhere except a string DECL fed by a SLOT_LOADED variable
+// and a LOAD_INT of a variable the program does not declare.
+static int verifyProgram(Interp *ctx, size_t symTotal) {
+    unsigned char *slots = memAlloc(MEM_CODEGEN, (size_t)ctx->prog.maxDepth + 1);
+    unsigned char *symTypes = memCalloc(MEM_CODEGEN, symTotal ? symTotal : 1, 1);
+    const uint32_t *code = ctx->prog.code;
+    int depth = 0, ok = 0;
+    size_t pc = 0;
+    while (slots && symTypes && pc < ctx->prog.codeLen) {
+        uint32_t op = code[pc++];
+        if (op >= OP_COUNT || pc + opArity[op] > ctx->prog.codeLen) break;
+        if ((op == OP_LOAD || op == OP_LOAD_INT || op == OP_DECL || op == OP_STORE)
+            && code[pc] >= symTotal) break;
+        if (op == OP_PUSH_STR && code[pc] >= ctx->prog.strCount) break;
+        if (op == OP_DECL && !strchr("ics", (int)code[pc + 1])) break;
+
+        unsigned char a = depth > 1 ? slots[depth - 2] : 0;   // operands, top last
+        unsigned char b = depth > 0 ? slots[depth - 1] : 0;
+        unsigned char pushed = 0;   // type left on top, 0 when nothing is pushed
+        int pops = 0, bad = 0;
+        switch (op) {
+        case OP_PUSH_INT:
+            pushed = SLOT_INT;
+            break;
+        case OP_LOAD_INT:
+            // Reads the variable's number; the VM checks untyped ones
+            bad = (symTypes[code[pc]] & (SLOT_STR | SLOT_ROPE)) != 0;
+            pushed = SLOT_INT;
+            break;
+        case OP_PUSH_CHAR:
+            pushed = SLOT_CHAR;
+            break;
+        case OP_PUSH_STR:
+            pushed = SLOT_STR;
+            break;
+        case OP_LOAD:
+            pushed = symTypes[code[pc]] ? symTypes[code[pc]] : SLOT_LOADED;
+            break;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+            // Expression arithmetic reads .num without looking at the tag
+            pops = 2;
+            bad = a != SLOT_INT || b != SLOT_INT;
+            pushed = SLOT_INT;
+            break;
+        case OP_NEG:
+            pops = 1;
+            bad = b != SLOT_INT;
+            pushed = SLOT_INT;
+            break;
+        case OP_DSUB: case OP_DMUL: case OP_DDIV:
+            pops = 2;
+            pushed = SLOT_INT;
+            break;
+        case OP_DNEG:
+            pops = 1;
+            pushed = SLOT_INT;
+            break;
+        case OP_DADD:
+            // Concatenates when either side is text, adds otherwise
+            pops = 2;
+            if ((a | b) & (SLOT_STR | SLOT_ROPE)) pushed |= SLOT_ROPE;
+            if ((a & (SLOT_INT | SLOT_CHAR)) && (b & (SLOT_INT | SLOT_CHAR))) pushed |= SLOT_INT;
+            break;
+        case OP_DECL:
+            pops = 1;
+            if (code[pc + 1] == 's') bad = b != SLOT_STR && b != SLOT_LOADED;
+            else bad = b != SLOT_INT;
+            if (!symTypes[code[pc]])
+                symTypes[code[pc]] = code[pc + 1] == 's' ? SLOT_STR : code[pc + 1] == 'c' ? SLOT_CHAR : SLOT_INT;
+            break;
+        case OP_STORE:
+            // variableReAssignment checks the tag against the variable's type,
+            // but a concatenation has no single text to store
+            pops = 1;
+            if (symTypes[code[pc]] == SLOT_STR) bad = b != SLOT_STR && b != SLOT_LOADED;
+            else if (symTypes[code[pc]]) bad = (b & ~(SLOT_INT | SLOT_CHAR)) != 0;
+            else bad = (b & SLOT_ROPE) != 0;
+            break;
+        case OP_DISPLAY:
+            pops = 1;
+            break;
+        }
+        if (bad || depth < pops) break;
+
+        depth += opEffect[op];
+        if (depth < 0 || depth > ctx->prog.maxDepth) break;
+        if (pushed) slots[depth - 1] = pushed;
+        pc += opArity[op];
+        if (op == OP_HALT) {
+            ok = pc == ctx->prog.codeLen;
+            break;
+        }
+    }
+    memFree(slots);
+    memFree(symTypes);
+    return ok;
+}
+
+int loadProgram(Interp *ctx, const char *path) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return 0;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    ctx->prog.image = size > 0 ? memAlloc(MEM_CODEGEN, (size_t)size) : NULL;
+    int ok = ctx->prog.image && fread(ctx->prog.image, 1, (size_t)size, in) == (size_t)size;
+    fclose(in);
+
+    const char *p = ctx->prog.image;
+    const char *end = p + (ok ? size : 0);
+    uint32_t magic = 0, version = 0, maxDepth = 0, syms = 0, strs = 0, codeLen = 0;
+    ok = ok && readWord(&p, end, &magic) && magic == PROGRAM_MAGIC
+            && readWord(&p, end, &version) && version == PROGRAM_VERSION
+            && readWord(&p, end, &maxDepth) && readWord(&p, end, &syms)
+            && readWord(&p, end, &strs) && readWord(&p, end, &codeLen);
+
+    // Interning in file order on a fresh table reproduces the compiled symbol IDs
+    for (uint32_t i = 0; ok && i < syms; i++) {
+        StrView name;
+        ok = readBytes(&p, end, &name) && internName(ctx, name.ptr, name.len) == (int)i;
+    }
+    ctx->prog.strings = ok ? memAlloc(MEM_CODEGEN, (strs ? strs : 1) * sizeof(StrView)) : NULL;
+    ok = ok && ctx->prog.strings;
+    for (uint32_t i = 0; ok && i < strs; i++) ok = readBytes(&p, end, &ctx->prog.strings[i]);
+    ctx->prog.strCount = ok ? strs : 0;
+
+    ok = ok && (size_t)(end - p) == (size_t)codeLen * sizeof(uint32_t);
+    ctx->prog.code = ok ? memAlloc(MEM_CODEGEN, (codeLen ? codeLen : 1) * sizeof(uint32_t)) : NULL;
+    ok = ok && ctx->prog.code;
+    if (ok) memcpy(ctx->prog.code, p, (size_t)codeLen * sizeof(uint32_t));
+    ctx->prog.codeLen = ok ? codeLen : 0;
+    ctx->prog.maxDepth = (int)maxDepth;
+
+    if (ok && !verifyProgram(ctx, syms)) ok = 0;
+    if (!ok) fprintf(stderr, "%s is not a valid sPyC program\n", path);
+    return ok;
+}
+
+/*------------------------------ State snapshots ---------------------------*/
+// A snapshot holds the variable table so a long prelude can be evaluated
+// once and later runs can start from its result. Layout, in native 32-bit
+// words: magic, version, variable count, heap size; then one fixed-size
+// entry per variable in declaration order; then the heap with every name
+// and string. Entries refer to the heap by offset and have a fixed size, so
+// loading needs no text parsing: loadState maps the file, checks every entry
+// against the heap bounds and copies it into varTable, then unmaps it.
+#define STATE_MAGIC 0x54535053u     // "SPST"
+#define STATE_VERSION 1u
+
+typedef struct stateEntry {
+    uint32_t nameOff;
+    uint32_t nameLen;
+    uint32_t type;       // 'i', 'c' or 's'
+    uint32_t value;      // int/char value, or heap offset of the string
+    uint32_t strLen;
+} stateEntry;
+
+int saveState(Interp *ctx, const char *path) {
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        fprintf(stderr, "Could not create %s\n", path);
+        return 0;
+    }
+
+    uint32_t heapLen = 0;
+    for (int i = 0; i < ctx->varCount; i++) {
+        const vars *v = &ctx->varTable[i];
+        heapLen += (uint32_t)strlen(symbolName(ctx, v->sym));
+        if (v->data_type == 's') heapLen += (uint32_t)varString(v).len;
+    }
+
+    int ok = writeWord(out, STATE_MAGIC) && writeWord(out, STATE_VERSION)
+          && writeWord(out, (uint32_t)ctx->varCount) && writeWord(out, heapLen);
+
+    uint32_t off = 0;
+    for (int i = 0; ok && i < ctx->varCount; i++) {
+        const vars *v = &ctx->varTable[i];
+        stateEntry e = { off, (uint32_t)strlen(symbolName(ctx, v->sym)), (uint32_t)v->data_type, (uint32_t)v->data.val, 0 };
+        off += e.nameLen;
+        if (v->data_type == 's') {
+            e.value = off;
+            e.strLen = (uint32_t)varString(v).len;
+            off += e.strLen;
+        }
+        ok = fwrite(&e, sizeof(e), 1, out) == 1;
+    }
+    for (int i = 0; ok && i < ctx->varCount; i++) {
+        const vars *v = &ctx->varTable[i];
+        const char *name = symbolName(ctx, v->sym);
+        ok = fwrite(name, 1, strlen(name), out) == strlen(name);
+        if (ok && v->data_type == 's') {
+            StrView str = varString(v);
+            ok = fwrite(str.ptr, 1, str.len, out) == str.len;
+        }
+    }
+
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "Failed to write %s\n", path);
+    return ok;
+}
+
+// Declares every variable of a snapshot without tracing; call it before
+// anything else declares variables
+int loadState(Interp *ctx, const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        if (fd >= 0) close(fd);
+        fprintf(stderr, "Could not open %s\n", path);
+        return 0;
+    }
+    size_t size = (size_t)st.st_size;
+    const char *image = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    uint32_t header[4] = { 0 };
+    int ok = image != MAP_FAILED && size >= sizeof(header);
+    if (ok) memcpy(header, image, sizeof(header));
+    ok = ok && header[0] == STATE_MAGIC && header[1] == STATE_VERSION
+            && (size - sizeof(header)) / sizeof(stateEntry) >= header[2]
+            && size - sizeof(header) - (size_t)header[2] * sizeof(stateEntry) == header[3];
+
+    const stateEntry *entries = (const stateEntry *)(image + sizeof(header));
+    const char *heap = (const char *)(entries + (ok ? header[2] : 0));
+    for (uint32_t i = 0; ok && i < header[2]; i++) {
+        const stateEntry *e = &entries[i];
+        ok = e->nameLen > 0 && e->nameOff <= header[3] && e->nameLen <= header[3] - e->nameOff
+          && (e->type == 'i' || e->type == 'c' || e->type == 's');
+        if (ok && e->type == 's')
+            ok = e->value <= header[3] && e->strLen <= header[3] - e->value;
+        if (!ok) break;
+
+        int sym = internName(ctx, heap + e->nameOff, e->nameLen);
+        if (getVariable(ctx, sym)) {
+            ok = 0;
+            break;
+        }
+        vars record = { .sym = sym, .data_type = (char)e->type };
+        if (e->type == 's') {
+            strValue str = { { heap + e->value, e->strLen }, NULL };
+            setVarString(&record, &str);
+        } else {
+            record.data.val = (int)e->value;
+        }
+        if (!appendVariable(ctx, &record)) {
+            releaseVarString(&record);
+            ok = 0;
+        }
+    }
+
+    if (image != MAP_FAILED) munmap((void *)image, size);
+    if (!ok) fprintf(stderr, "%s is not a valid sPyC state\n", path);
+    return ok;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+#define VM_CASE(op) L_##op:
+#define VM_NEXT() goto *vmLabels[code[pc++]]
+#else
+#define VM_CASE(op) case op:
+#define VM_NEXT() break
+#endif
+
+// Executes a loaded program; returns 0 on success like yyparse()
+int runProgram(Interp *ctx) {
+    Disp *stack = memAlloc(MEM_CODEGEN, (size_t)(ctx->prog.maxDepth + 1) * sizeof(Disp));
+    if (!stack) {
+        fprintf(stderr, "Failed to allocate VM stack\n");
+        return 1;
+    }
+    const uint32_t *code = ctx->prog.code;
+    size_t pc = 0;
+    Disp *sp = stack;   // next free slot
+    int result = 0;
+    vars *var;
+    int divisor;
+
+#ifdef VM_COMPUTED_GOTO
+    static void *vmLabels[OP_COUNT] = {
+        [OP_HALT] = &&L_OP_HALT, [OP_LINE] = &&L_OP_LINE,
+        [OP_PUSH_INT] = &&L_OP_PUSH_INT, [OP_PUSH_CHAR] = &&L_OP_PUSH_CHAR,
+        [OP_PUSH_STR] = &&L_OP_PUSH_STR, [OP_LOAD] = &&L_OP_LOAD, [OP_LOAD_INT] = &&L_OP_LOAD_INT,
+        [OP_ADD] = &&L_OP_ADD, [OP_SUB] = &&L_OP_SUB, [OP_MUL] = &&L_OP_MUL,
+        [OP_DIV] = &&L_OP_DIV, [OP_NEG] = &&L_OP_NEG,
+        [OP_DADD] = &&L_OP_DADD, [OP_DSUB] = &&L_OP_DSUB, [OP_DMUL] = &&L_OP_DMUL,
+        [OP_DDIV] = &&L_OP_DDIV, [OP_DNEG] = &&L_OP_DNEG,
+        [OP_DECL] = &&L_OP_DECL, [OP_STORE] = &&L_OP_STORE, [OP_DISPLAY] = &&L_OP_DISPLAY,
+    };
+    VM_NEXT();
+#else
+    for (;;) switch (code[pc++]) {
+#endif
+
+    VM_CASE(OP_HALT)
+        goto done;
+    VM_CASE(OP_LINE)
+        ctx->line = (int)code[pc++];
+        VM_NEXT();
+    VM_CASE(OP_PUSH_INT)
+        sp->type = 3;
+        sp->num = (int)code[pc++];
+        sp->pieces = NULL;
+        sp++;
+        VM_NEXT();
+    VM_CASE(OP_PUSH_CHAR)
+        sp->type = 2;
+        sp->ch = (char)code[pc++];
+        sp->pieces = NULL;
+        sp++;
+        VM_NEXT();
+    VM_CASE(OP_PUSH_STR)
+        sp->type = 1;
+        sp->str = ctx->prog.strings[code[pc++]];
+        sp->pieces = NULL;
+        sp->shared = NULL;
+        sp++;
+        VM_NEXT();
+    VM_CASE(OP_LOAD)
+        var = getVariable(ctx, (int)code[pc++]);
+        if (!var) goto undefined;
+        sp->pieces = NULL;
+        if (var->data_type == 's') {
+            sp->type = 1;
+            strValue value = variableString(var);
+            sp->str = value.text;
+            sp->shared = value.shared;
+        } else if (var->data_type == 'c') {
+            sp->type = 2;
+            sp->ch = (char)var->data.val;
+        } else {
+            sp->type = 3;
+            sp->num = var->data.val;
+        }
+        sp++;
+        VM_NEXT();
+    VM_CASE(OP_LOAD_INT)
+        var = getVariable(ctx, (int)code[pc++]);
+        if (!var) goto undefined;
+        if (var->data_type == 's') goto stringArithmetic;
+        sp->type = 3;
+        sp->num = var->data.val;
+        sp->pieces = NULL;
+        sp++;
+        VM_NEXT();
+    VM_CASE(OP_ADD)
+        sp--;
+        sp[-1].num += sp->num;
+        VM_NEXT();
+    VM_CASE(OP_SUB)
+        sp--;
+        sp[-1].num -= sp->num;
+        VM_NEXT();
+    VM_CASE(OP_MUL)
+        sp--;
+        sp[-1].num *= sp->num;
+        VM_NEXT();
+    VM_CASE(OP_DIV)
+        sp--;
+        if (sp->num == 0) goto divideByZero;
+        sp[-1].num /= sp->num;
+        VM_NEXT();
+    VM_CASE(OP_NEG)
+        sp[-1].num = -sp[-1].num;
+        VM_NEXT();
+    VM_CASE(OP_DADD)
+        sp--;
+        if (sp[-1].type == 1 || sp->type == 1) {
+            concatDisp(ctx, &sp[-1], &sp[-1], sp);
+        } else {
+            sp[-1].num = dispNumber(&sp[-1]) + dispNumber(sp);
+            sp[-1].type = 3;
+        }
+        VM_NEXT();
+    VM_CASE(OP_DSUB)
+        sp--;
+        sp[-1].num = dispNumber(&sp[-1]) - dispNumber(sp);
+        sp[-1].type = 3;
+        sp[-1].pieces = NULL;
+        VM_NEXT();
+    VM_CASE(OP_DMUL)
+        sp--;
+        sp[-1].num = dispNumber(&sp[-1]) * dispNumber(sp);
+        sp[-1].type = 3;
+        sp[-1].pieces = NULL;
+        VM_NEXT();
+    VM_CASE(OP_DDIV)
+        sp--;
+        divisor = dispNumber(sp);
+        if (divisor == 0) goto displayDivideByZero;
+        sp[-1].num = dispNumber(&sp[-1]) / divisor;
+        sp[-1].type = 3;
+        sp[-1].pieces = NULL;
+        VM_NEXT();
+    VM_CASE(OP_DNEG)
+        sp[-1].num = -dispNumber(&sp[-1]);
+        sp[-1].type = 3;
+        sp[-1].pieces = NULL;
+        VM_NEXT();
+    VM_CASE(OP_DECL)
+        sp--;
+        if (code[pc + 1] == 's') {
+            // The verifier lets a --load-state variable through untyped
+            if (sp->type != 1) goto notString;
+            createVariable(ctx, "string", (int)code[pc], 0, &(strValue){ sp->str, sp->shared });
+        } else {
+            createVariable(ctx, typeName((char)code[pc + 1]), (int)code[pc], sp->num, NULL);
+        }
+        pc += 2;
+        if (ctx->hasError) goto failed;
+        if (ctx->profiling) profileStatement(ctx);
+        if (sp == stack) arenaReset(ctx);
+        VM_NEXT();
+    VM_CASE(OP_STORE)
+        sp--;
+        if (sp->type == 1) variableReAssignment(ctx, (int)code[pc], 0, &(strValue){ sp->str, sp->shared });
+        else variableReAssignment(ctx, (int)code[pc], sp->type == 2 ? sp->ch : sp->num, NULL);
+        pc++;
+        if (ctx->hasError) goto failed;
+        if (ctx->profiling) profileStatement(ctx);
+        if (sp == stack) arenaReset(ctx);
+        VM_NEXT();
+    VM_CASE(OP_DISPLAY)
+        sp--;
+        outPrintf(ctx, OUT_DISPLAY, "LINE %d: ", ctx->line);
+        printDisp(ctx, sp);
+        outWrite(ctx, OUT_DISPLAY, "\n", 1);
+        if (ctx->profiling) profileStatement(ctx);
+        if (sp == stack) arenaReset(ctx);
+        VM_NEXT();
+
+#ifndef VM_COMPUTED_GOTO
+    default:
+        goto failed;
+    }
+#endif
+
+undefined:
+    yyerror(ctx, "Undefined variable '%s' on line %d", symbolName(ctx, (int)code[pc - 1]), ctx->line);
+    goto failed;
+stringArithmetic:
+    yyerror(ctx, "Cannot perform arithmetic operations on variable %s: string literals, on line %d.",
+            symbolName(ctx, (int)code[pc - 1]), ctx->line);
+    goto failed;
+divideByZero:
+    yyerror(ctx, "Division by zero on line %d", ctx->line);
+    goto failed;
+displayDivideByZero:
+    yyerror(ctx, "Division by zero in display on line %d", ctx->line);
+    goto failed;
+notString:
+    yyerror(ctx, "Cannot assign non-string variable to string variable '%s' on line %d", symbolName(ctx, (int)code[pc]), ctx->line);
+failed:
+    result = 1;
+done:
+    memFree(stack);
+    return result;
+}
+
+void cleanupProgram(Interp *ctx) {
+    memFree(ctx->prog.code);
+    memFree(ctx->prog.strings);
+    memFree(ctx->prog.image);
+    memset(&ctx->prog, 0, sizeof(ctx->prog));
+    ctx->prog.lastLine = -1;
+}
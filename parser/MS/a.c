@@ -4,6 +4,9 @@
 #include <ctype.h>
 #include <regex.h>
 
+#define SPYC_MEM_IMPLEMENTATION
+#include "../../spyc_mem.h"
+
 typedef struct symbols
 {
     char data_type;
@@ -113,7 +116,7 @@ char *trim(char *str)
 // Add entry to history (records everything chronologically)
 void add_to_history(int line, char data_type, const char *variable, const char *value, const char *action, int is_valid)
 {
-    history *new_hist = malloc(sizeof(history));
+    history *new_hist = memAlloc(MEM_HISTORY, sizeof(history));
     if (!new_hist)
     {
         fprintf(stderr, "Failed to allocate memory for history\n");
@@ -122,9 +125,9 @@ void add_to_history(int line, char data_type, const char *variable, const char *
 
     new_hist->line = line;
     new_hist->data_type = data_type;
-    new_hist->variable = strdup(variable);
-    new_hist->value = value ? strdup(value) : strdup("NULL");
-    new_hist->action = strdup(action);
+    new_hist->variable = memStrdup(MEM_HISTORY, variable);
+    new_hist->value = value ? memStrdup(MEM_HISTORY, value) : memStrdup(MEM_HISTORY, "NULL");
+    new_hist->action = memStrdup(MEM_HISTORY, action);
     new_hist->is_valid = is_valid;
     new_hist->next = NULL;
 
@@ -237,7 +240,7 @@ int is_char_literal(const char *str)
 void extract_identifiers(const char *expr, char identifiers[][64], int *count)
 {
     *count = 0;
-    char *expr_copy = strdup(expr);
+    char *expr_copy = memStrdup(MEM_LEXER, expr);
     char *token;
     char delimiters[] = " \t\n+-*/=(),;";
 
@@ -271,7 +274,7 @@ void extract_identifiers(const char *expr, char identifiers[][64], int *count)
         token = strtok(NULL, delimiters);
     }
 
-    free(expr_copy);
+    memFree(expr_copy);
 }
 
 // Add VALID variable to symbol table only
@@ -284,14 +287,14 @@ void add_to_symbol_table(char data_type, const char *id, const char *value, int
         // Update existing variable value only
         if (value)
         {
-            free(existing->value);
-            existing->value = strdup(value);
+            memFree(existing->value);
+            existing->value = memStrdup(MEM_SYMTAB, value);
         }
     }
     else
     {
         // Create new variable
-        symbols *new_var = malloc(sizeof(symbols));
+        symbols *new_var = memAlloc(MEM_SYMTAB, sizeof(symbols));
         if (!new_var)
         {
             fprintf(stderr, "Failed to allocate memory for symbol\n");
@@ -299,8 +302,8 @@ void add_to_symbol_table(char data_type, const char *id, const char *value, int
         }
 
         new_var->data_type = data_type;
-        new_var->id = strdup(id);
-        new_var->value = value ? strdup(value) : strdup("NULL");
+        new_var->id = memStrdup(MEM_SYMTAB, id);
+        new_var->value = value ? memStrdup(MEM_SYMTAB, value) : memStrdup(MEM_SYMTAB, "NULL");
         new_var->line_declared = line;
         new_var->next = NULL;
 
@@ -319,15 +322,15 @@ void add_to_symbol_table(char data_type, const char *id, const char *value, int
 // Create error log
 void create_error_log(char *error_type, char *error_msgs, int line)
 {
-    error *new_error = malloc(sizeof(error));
+    error *new_error = memAlloc(MEM_DIAG, sizeof(error));
     if (!new_error)
     {
         printf("Failed to create error NODE.\n");
         return;
     }
     new_error->line = line;
-    new_error->error_type = strdup(error_type);
-    new_error->err_msg = strdup(error_msgs);
+    new_error->error_type = memStrdup(MEM_DIAG, error_type);
+    new_error->err_msg = memStrdup(MEM_DIAG, error_msgs);
     new_error->next = NULL;
 
     if (!list_error_head)
@@ -367,7 +370,7 @@ void parse_single_statement(char *input, int line)
     int current_stmt_count = 0;
 
     // Parse variable declarations/assignments separated by commas
-    char *start_copy = strdup(start);
+    char *start_copy = memStrdup(MEM_LEXER, start);
     char *saveptr;
     char *token = strtok_r(start_copy, ",", &saveptr);
     int var_position = 0; // Track position of variable in declaration
@@ -560,7 +563,7 @@ void parse_single_statement(char *input, int line)
         token = strtok_r(NULL, ",", &saveptr);
     }
 
-    free(start_copy);
+    memFree(start_copy);
 }
 
 // Parse syntax and extract variables with proper C semantics
@@ -576,7 +579,7 @@ void parse_syntax(char *raw_input, int line)
     }
 
     // Create a copy to work with
-    char *input_copy = strdup(raw_input);
+    char *input_copy = memStrdup(MEM_LEXER, raw_input);
     char *ptr = input_copy;
 
     // Split by semicolons and process each statement
@@ -609,7 +612,7 @@ void parse_syntax(char *raw_input, int line)
         parse_single_statement(statement, line);
     }
 
-    free(input_copy);
+    memFree(input_copy);
 }
 
 // Check each code if it's valid (optional additional validations)
@@ -675,6 +678,7 @@ void print_errors()
 // Example usage
 int main()
 {
+    memReportAtExit();
     printf("=== Test Cases ===\n");
     int line = 1;
     FILE *input = fopen("input.txt", "r");
@@ -3,6 +3,11 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <limits.h>
+#include <time.h>
+
+#define SPYC_MEM_IMPLEMENTATION
+#include "../spyc_mem.h"
 
 // Data type constants
 #define TYPE_INT 1
@@ -25,29 +30,35 @@ typedef enum
     NODE_BINARY_OP
 } NodeType;
 
-// The structure for our AST
+// The structure for our AST: one 8-byte node of the program-wide post-order
+// array ast_nodes. A binary node's right operand is the node just before it,
+// so only the left operand's index is stored.
 typedef struct AstNode
 {
-    NodeType type;
+    uint8_t type; // NodeType
+    char op;      // For NODE_BINARY_OP
     union
     {
         // For NODE_NUMBER
-        int value;
+        int32_t value;
 
-        // For NODE_VARIABLE
-        char *var_name;
+        // For NODE_VARIABLE: index in symbol_table
+        uint32_t var;
 
         // For NODE_BINARY_OP
-        struct
-        {
-            char op;
-            struct AstNode *left;
-            struct AstNode *right;
-        } op_details;
+        uint32_t left;
     };
 } AstNode;
 
-// Symbol table structure
+// one expression: 'count' nodes starting at ast_nodes[first], root last
+typedef struct
+{
+    uint32_t first;
+    uint32_t count;
+} AstSpan;
+
+// Symbol table structure: records sit in declaration order in the
+// symbol_table array and are found by name through symbol_index
 typedef struct vars
 {
     char *id;
@@ -59,7 +70,7 @@ typedef struct vars
     } data;
     int has_value;
     int reg_num; //*destination* register
-    struct vars *next;
+    int is_temp; // "__temp_" result of a pure expression, kept out of .data
 } vars;
 
 // Error list structure
@@ -76,159 +87,326 @@ typedef struct history
 {
     int line_num;
     int operation_type;
-    char *variable_name;
+    int var_index;       // destination in symbol_table
+    char *variable_name; // the destination's id, owned by symbol_table
     int data_type;
 
-    // stores blueprint of the expression
-    AstNode *expression_tree;
+    // stores blueprint of the expression (count 0 when there is none)
+    AstSpan expression_tree;
 
     char *original_line;
     struct history *next;
 } history;
 
-// global symbol table, error list, and history
-vars *symbol_table = NULL;
-errorList *error_list_head = NULL;
-history *history_head = NULL;
-history *history_tail = NULL;
-int next_register = 1;      // start from r1 (r0 is reserved)
-int next_temp_register = 8; // start using r8 for temp calculations
-int tokCount = 0;
+// --- Source Input ---
+// input is read in chunks of this size; only a statement longer than a chunk
+// makes the buffer grow
+#define SOURCE_CHUNK 65536
+
+// input.txt cut into statements at ';', so a statement may span lines and a
+// line may be any length
+typedef struct
+{
+    FILE *file;
+    char *buf; // buf[pos, len) is input not yet tokenized
+    size_t pos;
+    size_t len;
+    size_t cap;
+    int line_num; // line of buf[pos]
+    int eof;
+} SourceReader;
+
+// --- Tokens ---
+typedef enum
+{
+    TOK_INT,      // keyword int
+    TOK_CHAR,     // keyword char
+    TOK_IDENT,
+    TOK_NUMBER,
+    TOK_CHAR_LIT, // 'A'
+    TOK_OP,       // + - * /
+    TOK_LPAREN,
+    TOK_RPAREN,
+    TOK_ASSIGN,
+    TOK_COMMA,
+    TOK_SEMI,
+    TOK_OTHER // any other character
+} TokenKind;
+
+// one token of the current statement; its text is src[start, start + len)
+typedef struct
+{
+    uint8_t kind; // TokenKind
+    char op;      // For TOK_OP
+    uint32_t start;
+    uint32_t len;
+    int value; // For TOK_NUMBER and TOK_CHAR_LIT
+} Token;
+
+// --- Compiler Context ---
+// all state of one compilation; functions take it as their first argument,
+// so separate programs can be compiled on different threads at once
+typedef struct Compiler
+{
+    // symbol table, error list, and history
+    vars *symbol_table; // dense, in declaration order
+    int symbol_count;
+    int symbol_cap;
+    int *symbol_index; // open addressing on the name: index + 1, 0 when empty
+    int symbol_index_cap; // power of two
+    errorList *error_list_head;
+    history *history_head;
+    history *history_tail;
+    int next_register;      // start from r1 (r0 is reserved)
+    int next_temp_register; // start using r8 for temp calculations
+    int tokCount;
+
+    // every expression of the program, flattened in post-order
+    AstNode *ast_nodes;
+    uint32_t ast_node_count;
+    uint32_t ast_node_cap;
+
+    // tokens of the statement being compiled, ending with its ';'
+    Token *tokens;
+    int token_cap;
+    const char *src; // statement the tokens point into
+    char *span;      // scratch text returned by token_span
+    size_t span_cap;
+
+    // expression parser cursor
+    int expr_tok;  // index of the next token of the expression
+    int expr_end;  // index just past the expression's last token
+    int expr_line; // current line number for error reporting
+} Compiler;
 
 // --- Function Prototypes for AST ---
-AstNode *create_number_node(int value);
-AstNode *create_variable_node(char *var_name);
-AstNode *create_binary_op_node(char op, AstNode *left, AstNode *right);
-void free_ast(AstNode *node);
-int generate_mips_for_ast(FILE *output_file, AstNode *node);
+uint32_t create_number_node(Compiler *cc, int value);
+uint32_t create_variable_node(Compiler *cc, int var_index);
+uint32_t create_binary_op_node(Compiler *cc, char op, uint32_t left, uint32_t right);
+void free_ast_nodes(Compiler *cc);
+void *grow_stack(void *items, int *cap, size_t item_size);
+int generate_mips_for_ast(Compiler *cc, FILE *output_file, AstSpan tree);
 
 // Function prototypes
-vars *find_variable(const char *id);
-int add_variable(const char *id, int data_type, int line_num);
-void set_variable_value_in_table(const char *id, int int_val);
-void add_error(int line_num, const char *error_type, const char *line_content);
-void add_history_entry(int line_num, int op_type, const char *var_name, int data_type, AstNode *tree, const char *original_line);
-void print_symbol_table();
-void print_errors();
-void print_history_ast(AstNode *node);
-void print_history();
-void generate_mips64();
-void free_symbol_table();
-void free_error_list();
-void free_history();
-char *extract_variable_name(const char *declaration);
-char *extract_data_type(const char *declaration);
-char *extract_value(const char *declaration);
-int is_declaration(const char *line);
-void process_declaration(const char *declaration, int line_num);
-void process_assignment(const char *assignment, int line_num);
+vars *find_variable(Compiler *cc, const char *id);
+int find_variable_index(Compiler *cc, const char *id);
+int add_variable(Compiler *cc, const char *id, int data_type, int line_num);
+void set_variable_value_in_table(Compiler *cc, const char *id, int int_val);
+void add_error(Compiler *cc, int line_num, const char *error_type, const char *line_content);
+void add_history_entry(Compiler *cc, int line_num, int op_type, int var_index, int data_type, AstSpan tree, const char *original_line);
+void print_symbol_table(Compiler *cc);
+void print_errors(Compiler *cc);
+void print_history_ast(Compiler *cc, AstSpan tree);
+void print_history(Compiler *cc);
+void generate_mips64(Compiler *cc, char *filename);
+void free_symbol_table(Compiler *cc);
+void free_error_list(Compiler *cc);
+void free_history(Compiler *cc);
+Compiler *create_compiler();
+void free_compiler(Compiler *cc);
+int refill_source(SourceReader *in);
+void close_source(SourceReader *in);
+int tokenize_statement(Compiler *cc, SourceReader *in, int *line_num);
+const char *token_span(Compiler *cc, int from, int to);
+void free_tokens(Compiler *cc);
+void process_statement(Compiler *cc, int count, int line_num);
+void process_declaration(Compiler *cc, int count, int line_num);
+void process_assignment(Compiler *cc, int count, int equals, int line_num);
 int get_register_number(char *reg);
-void convert_mips64_to_binhex(char *filename);
+void convert_mips64_to_binhex(Compiler *cc, char *filename);
+double stage_clock();
+void report_stage(const char *stage, double started);
 
 // --- PEMDAS-COMPLIANT PARSER PROTOTYPES ---
-AstNode *parse_expression_to_ast(const char *expression_str, int line_num);
-AstNode *parse_expression(); // Handles + and -
-AstNode *parse_term();       // Handles * and /
-AstNode *parse_unary();      // Handles unary + and -
-AstNode *parse_atom();       // Handles numbers, vars, (and parentheses)
+AstSpan parse_expression_to_ast(Compiler *cc, int first, int end, int line_num);
+uint32_t parse_expression(Compiler *cc); // Handles + - * /, unary + and -, and parentheses
+uint32_t parse_atom(Compiler *cc);       // Handles numbers, chars and vars
 
 // --- AST Helper Functions ---
 
+// appends a node to ast_nodes and returns its index
+uint32_t new_ast_node(Compiler *cc, uint8_t type)
+{
+    if (cc->ast_node_count == cc->ast_node_cap)
+    {
+        uint32_t new_cap = cc->ast_node_cap ? cc->ast_node_cap * 2 : 1024;
+        AstNode *grown = (AstNode *)memRealloc(MEM_AST, cc->ast_nodes, (size_t)new_cap * sizeof(AstNode));
+        if (grown == NULL || new_cap < cc->ast_node_cap)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        cc->ast_nodes = grown;
+        cc->ast_node_cap = new_cap;
+    }
+    cc->ast_nodes[cc->ast_node_count].type = type;
+    cc->ast_nodes[cc->ast_node_count].op = 0;
+    return cc->ast_node_count++;
+}
+
 // create a simple number node
-AstNode *create_number_node(int value)
+uint32_t create_number_node(Compiler *cc, int value)
 {
-    AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-    node->type = NODE_NUMBER;
-    node->value = value;
+    uint32_t node = new_ast_node(cc, NODE_NUMBER);
+    cc->ast_nodes[node].value = value;
     return node;
 }
 
-// create node for a variable name
-AstNode *create_variable_node(char *var_name)
+// create node for a declared variable
+uint32_t create_variable_node(Compiler *cc, int var_index)
 {
-    AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-    node->type = NODE_VARIABLE;
-    node->var_name = strdup(var_name);
+    uint32_t node = new_ast_node(cc, NODE_VARIABLE);
+    cc->ast_nodes[node].var = var_index;
     return node;
 }
 
-// create binary operation node (the "blueprint")
-AstNode *create_binary_op_node(char op, AstNode *left, AstNode *right)
+// create binary operation node (the "blueprint"); both operands must be
+// complete, with 'right' the most recently created node
+uint32_t create_binary_op_node(Compiler *cc, char op, uint32_t left, uint32_t right)
 {
-    AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-    node->type = NODE_BINARY_OP;
-    node->op_details.op = op;
-    node->op_details.left = left;
-    node->op_details.right = right;
+    (void)right; // implied by post-order: always the node before this one
+    uint32_t node = new_ast_node(cc, NODE_BINARY_OP);
+    cc->ast_nodes[node].op = op;
+    cc->ast_nodes[node].left = left;
     return node;
 }
 
-// recursively frees all memory associated with an AST
-void free_ast(AstNode *node)
+// releases every expression of the program at once
+void free_ast_nodes(Compiler *cc)
 {
-    if (!node)
-        return;
+    memFree(cc->ast_nodes);
+    cc->ast_nodes = NULL;
+    cc->ast_node_count = cc->ast_node_cap = 0;
+}
 
-    if (node->type == NODE_BINARY_OP)
-    {
-        free_ast(node->op_details.left);
-        free_ast(node->op_details.right);
-    }
-    else if (node->type == NODE_VARIABLE)
+// doubles a work stack used to walk or build deep trees without recursion
+void *grow_stack(void *items, int *cap, size_t item_size)
+{
+    int new_cap = *cap ? *cap * 2 : 64;
+    void *grown = memRealloc(MEM_AST, items, new_cap * item_size);
+    if (grown == NULL)
     {
-        free(node->var_name);
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
     }
-    free(node);
+    *cap = new_cap;
+    return grown;
 }
 
-// find a variable in the symbol table
-vars *find_variable(const char *id)
+// one pending node of the print walk; stage counts finished children
+typedef struct
 {
-    vars *current = symbol_table;
-    while (current != NULL)
+    uint32_t node;
+    int stage;
+} AstFrame;
+
+void push_frame(AstFrame **stack, int *count, int *cap, uint32_t node)
+{
+    if (*count == *cap)
+        *stack = grow_stack(*stack, cap, sizeof(AstFrame));
+    (*stack)[*count].node = node;
+    (*stack)[*count].stage = 0;
+    (*count)++;
+}
+
+// FNV-1a over the variable name
+static uint32_t hash_name(const char *id)
+{
+    uint32_t hash = 2166136261u;
+    while (*id)
     {
-        if (strcmp(current->id, id) == 0)
-        {
-            return current;
-        }
-        current = current->next;
+        hash ^= (unsigned char)*id++;
+        hash *= 16777619u;
     }
-    return NULL;
+    return hash;
+}
+
+// slot of 'id' in symbol_index: its entry, or the empty slot it would take
+static int *find_variable_slot(Compiler *cc, const char *id)
+{
+    uint32_t mask = cc->symbol_index_cap - 1;
+    uint32_t i = hash_name(id) & mask;
+    while (cc->symbol_index[i] != 0 && strcmp(cc->symbol_table[cc->symbol_index[i] - 1].id, id) != 0)
+        i = (i + 1) & mask;
+    return &cc->symbol_index[i];
+}
+
+// doubles symbol_index and re-inserts every variable
+static int grow_symbol_index(Compiler *cc)
+{
+    int new_cap = cc->symbol_index_cap ? cc->symbol_index_cap * 2 : 256;
+    int *new_index = (int *)memCalloc(MEM_SYMTAB, new_cap, sizeof(int));
+    if (new_index == NULL)
+        return 0;
+    memFree(cc->symbol_index);
+    cc->symbol_index = new_index;
+    cc->symbol_index_cap = new_cap;
+    for (int i = 0; i < cc->symbol_count; i++)
+        *find_variable_slot(cc, cc->symbol_table[i].id) = i + 1;
+    return 1;
+}
+
+// dense index of a variable, or -1 when it is not declared
+int find_variable_index(Compiler *cc, const char *id)
+{
+    if (cc->symbol_count == 0)
+        return -1;
+    return *find_variable_slot(cc, id) - 1;
+}
+
+// find a variable in the symbol table. The record moves when the table
+// grows, so do not hold it across add_variable.
+vars *find_variable(Compiler *cc, const char *id)
+{
+    int index = find_variable_index(cc, id);
+    return index < 0 ? NULL : &cc->symbol_table[index];
 }
 
 // add a new variable to the symbol table
-int add_variable(const char *id, int data_type, int line_num)
+int add_variable(Compiler *cc, const char *id, int data_type, int line_num)
 {
-    if (find_variable(id) != NULL)
+    if (find_variable(cc, id) != NULL)
     {
-        add_error(line_num, ERROR_REDECLARATION, NULL);
+        add_error(cc, line_num, ERROR_REDECLARATION, NULL);
         return 0;
     }
-    vars *new_var = (vars *)malloc(sizeof(vars));
-    if (new_var == NULL)
+    // keep the load factor at or below 1/2 so probe chains stay short
+    if ((cc->symbol_count + 1) * 2 > cc->symbol_index_cap && !grow_symbol_index(cc))
     {
         fprintf(stderr, "Memory allocation failed\n");
         return 0;
     }
-    new_var->id = strdup(id);
+    if (cc->symbol_count == cc->symbol_cap)
+    {
+        int new_cap = cc->symbol_cap ? cc->symbol_cap * 2 : 256;
+        vars *grown = (vars *)memRealloc(MEM_SYMTAB, cc->symbol_table, new_cap * sizeof(vars));
+        if (grown == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            return 0;
+        }
+        cc->symbol_table = grown;
+        cc->symbol_cap = new_cap;
+    }
+    vars *new_var = &cc->symbol_table[cc->symbol_count];
+    new_var->id = memStrdup(MEM_SYMTAB, id);
     if (new_var->id == NULL)
     {
-        free(new_var);
         return 0;
     }
     new_var->data_type = data_type;
     new_var->has_value = 0;
     new_var->data.val = 0;
-    new_var->reg_num = next_register++;
-    new_var->next = symbol_table;
-    symbol_table = new_var;
+    new_var->reg_num = cc->next_register++;
+    new_var->is_temp = strncmp(id, "__temp_", 7) == 0;
+    *find_variable_slot(cc, id) = ++cc->symbol_count;
     return 1;
 }
 
 // set the value of an existing variable
-void set_variable_value_in_table(const char *id, int int_val)
+void set_variable_value_in_table(Compiler *cc, const char *id, int int_val)
 {
-    vars *var = find_variable(id);
+    vars *var = find_variable(cc, id);
     if (var != NULL)
     {
         var->has_value = 1;
@@ -240,18 +418,18 @@ void set_variable_value_in_table(const char *id, int int_val)
 }
 
 // add an error to the error list
-void add_error(int line_num, const char *error_type, const char *line_content)
+void add_error(Compiler *cc, int line_num, const char *error_type, const char *line_content)
 {
-    errorList *new_error = (errorList *)malloc(sizeof(errorList));
+    errorList *new_error = (errorList *)memAlloc(MEM_DIAG, sizeof(errorList));
     if (new_error == NULL)
     {
         fprintf(stderr, "Memory allocation failed for error\n");
     }
     new_error->line_error = line_num;
-    new_error->error_type = strdup(error_type);
-    new_error->line_content = line_content ? strdup(line_content) : NULL;
-    new_error->next = error_list_head;
-    error_list_head = new_error;
+    new_error->error_type = memStrdup(MEM_DIAG, error_type);
+    new_error->line_content = line_content ? memStrdup(MEM_DIAG, line_content) : NULL;
+    new_error->next = cc->error_list_head;
+    cc->error_list_head = new_error;
     fprintf(stderr, "\n--- ERROR DETECTED ---\n");
     fprintf(stderr, "LINE %d: %s\n", new_error->line_error, new_error->error_type);
     if (new_error->line_content)
@@ -262,9 +440,9 @@ void add_error(int line_num, const char *error_type, const char *line_content)
 }
 
 // --- History Entry ---
-void add_history_entry(int line_num, int op_type, const char *var_name, int data_type, AstNode *tree, const char *original_line)
+void add_history_entry(Compiler *cc, int line_num, int op_type, int var_index, int data_type, AstSpan tree, const char *original_line)
 {
-    history *new_entry = (history *)malloc(sizeof(history));
+    history *new_entry = (history *)memAlloc(MEM_HISTORY, sizeof(history));
     if (new_entry == NULL)
     {
         fprintf(stderr, "Memory allocation failed for history\n");
@@ -272,411 +450,586 @@ void add_history_entry(int line_num, int op_type, const char *var_name, int data
     }
     new_entry->line_num = line_num;
     new_entry->operation_type = op_type;
-    new_entry->variable_name = strdup(var_name);
+    new_entry->var_index = var_index;
+    new_entry->variable_name = cc->symbol_table[var_index].id;
     new_entry->data_type = data_type;
     new_entry->expression_tree = tree; // Store the AST
-    new_entry->original_line = original_line ? strdup(original_line) : NULL;
+    new_entry->original_line = original_line ? memStrdup(MEM_HISTORY, original_line) : NULL;
     new_entry->next = NULL;
 
-    if (history_tail == NULL)
+    if (cc->history_tail == NULL)
     {
-        history_head = new_entry;
-        history_tail = new_entry;
+        cc->history_head = new_entry;
+        cc->history_tail = new_entry;
     }
     else
     {
-        history_tail->next = new_entry;
-        history_tail = new_entry;
+        cc->history_tail->next = new_entry;
+        cc->history_tail = new_entry;
     }
 }
 
-//(Helper functions for string extraction
-char *extract_variable_name(const char *declaration)
+// --- Tokenizer ---
+
+// drops the tokenized part of the buffer and appends the next chunk of the
+// file; returns 0 once the file is exhausted
+int refill_source(SourceReader *in)
 {
-    if (declaration == NULL)
-        return NULL;
-    char *temp = strdup(declaration);
-    if (temp == NULL)
-        return NULL;
-    char *token;
-    char *name = NULL;
-    char *start = temp;
-    while (isspace(*start))
-        start++;
-    token = strtok(start, " \t\n;=,");
-    if (token && (strcmp(token, "int") == 0 || strcmp(token, "char") == 0))
+    if (in->eof)
+        return 0;
+
+    if (in->pos > 0)
     {
-        token = strtok(NULL, " \t\n;=,");
+        memmove(in->buf, in->buf + in->pos, in->len - in->pos);
+        in->len -= in->pos;
+        in->pos = 0;
     }
-    if (token)
+    if (in->cap - in->len < SOURCE_CHUNK)
     {
-        name = strdup(token);
+        size_t new_cap = in->cap ? in->cap * 2 : SOURCE_CHUNK;
+        char *grown = (char *)memRealloc(MEM_LEXER, in->buf, new_cap);
+        if (grown == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        in->buf = grown;
+        in->cap = new_cap;
     }
-    free(temp);
-    return name;
-}
 
-// extract the data type from a declaration string
-char *extract_data_type(const char *declaration)
-{
-    if (declaration == NULL)
-        return NULL;
-    char *temp = strdup(declaration);
-    if (temp == NULL)
-        return NULL;
-    char *token;
-    char *type = NULL;
-    char *start = temp;
-    while (isspace(*start))
-        start++;
-    token = strtok(start, " \t\n");
-    if (token && (strcmp(token, "int") == 0 || strcmp(token, "char") == 0))
+    size_t got = fread(in->buf + in->len, 1, in->cap - in->len, in->file);
+    if (got == 0)
     {
-        type = strdup(token);
+        in->eof = 1;
+        return 0;
     }
-    free(temp);
-    return type;
+    in->len += got;
+    return 1;
 }
 
-// extract the value part from a declaration or assignment string
-char *extract_value(const char *declaration)
+void close_source(SourceReader *in)
 {
-    if (declaration == NULL)
-        return NULL;
-    const char *equals = strchr(declaration, '=');
-    if (equals == NULL)
-        return NULL;
-    equals++;
-    while (isspace(*equals))
-        equals++;
-    const char *end = equals;
-    while (*end && *end != ';')
-        end++;
-    size_t len = end - equals;
-    if (len == 0)
-        return NULL;
-    char *value = (char *)malloc(len + 1);
-    if (value == NULL)
-        return NULL;
-    strncpy(value, equals, len);
-    value[len] = '\0';
-    char *trim_end = value + strlen(value) - 1;
-    while (trim_end > value && isspace(*trim_end))
+    fclose(in->file);
+    memFree(in->buf);
+    in->file = NULL;
+    in->buf = NULL;
+}
+
+// scans the next statement, up to and including its ';' (or to the end of
+// the input), into tokens and returns its token count, 0 at the end of the
+// input. *line_num is set to the line the statement starts on.
+// This is the only pass over the input bytes; everything after works on
+// tokens. A token cut by a chunk boundary is scanned again after the refill.
+int tokenize_statement(Compiler *cc, SourceReader *in, int *line_num)
+{
+    int count = 0;
+    size_t off = 0; // scan position relative to in->pos, the statement start
+
+    while (1)
     {
-        *trim_end = '\0';
-        trim_end--;
+        if (in->pos + off == in->len)
+        {
+            if (!refill_source(in))
+                break;
+            continue;
+        }
+        const char *src = in->buf + in->pos;
+        size_t avail = in->len - in->pos;
+        char c = src[off];
+
+        if (isspace(c))
+        {
+            if (c == '\n')
+                in->line_num++;
+            // whitespace before the statement is dropped right away, so
+            // blank lines never pile up in the buffer
+            if (count == 0)
+                in->pos++;
+            else
+                off++;
+            continue;
+        }
+
+        size_t end = off + 1;
+        int kind;
+        if (isdigit(c))
+        {
+            while (end < avail && isdigit(src[end]))
+                end++;
+            kind = TOK_NUMBER;
+        }
+        else if (isalpha(c) || c == '_')
+        {
+            while (end < avail && (isalnum(src[end]) || src[end] == '_'))
+                end++;
+            kind = TOK_IDENT;
+        }
+        else if (c == '\'')
+        {
+            if (end < avail)
+                end++; // the character itself
+            if (end < avail && src[end] == '\'')
+                end++; // Skip closing '
+            kind = TOK_CHAR_LIT;
+        }
+        else
+        {
+            switch (c)
+            {
+            case '+':
+            case '-':
+            case '*':
+            case '/':
+                kind = TOK_OP;
+                break;
+            case '(':
+                kind = TOK_LPAREN;
+                break;
+            case ')':
+                kind = TOK_RPAREN;
+                break;
+            case '=':
+                kind = TOK_ASSIGN;
+                break;
+            case ',':
+                kind = TOK_COMMA;
+                break;
+            case ';':
+                kind = TOK_SEMI;
+                break;
+            default:
+                kind = TOK_OTHER;
+                break;
+            }
+        }
+
+        // a name, number or char literal that reaches the end of the buffer
+        // may continue in the next chunk
+        if (end == avail && (kind == TOK_NUMBER || kind == TOK_IDENT || kind == TOK_CHAR_LIT) && refill_source(in))
+            continue;
+
+        if (count == cc->token_cap)
+        {
+            int new_cap = cc->token_cap ? cc->token_cap * 2 : 64;
+            Token *grown = (Token *)memRealloc(MEM_LEXER, cc->tokens, new_cap * sizeof(Token));
+            if (grown == NULL)
+            {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            cc->tokens = grown;
+            cc->token_cap = new_cap;
+        }
+        if (count == 0)
+            *line_num = in->line_num;
+        Token *tok = &cc->tokens[count++];
+        tok->kind = kind;
+        tok->op = kind == TOK_OP ? c : 0;
+        tok->start = off;
+        tok->len = end - off;
+        tok->value = 0;
+
+        if (kind == TOK_NUMBER)
+        {
+            // saturates like atoi on overlong numbers
+            long value = 0;
+            for (size_t i = off; i < end; i++)
+            {
+                int digit = src[i] - '0';
+                value = value > (LONG_MAX - digit) / 10 ? LONG_MAX : value * 10 + digit;
+            }
+            tok->value = (int)value;
+        }
+        else if (kind == TOK_IDENT)
+        {
+            if (end - off == 3 && strncmp(src + off, "int", 3) == 0)
+                tok->kind = TOK_INT;
+            else if (end - off == 4 && strncmp(src + off, "char", 4) == 0)
+                tok->kind = TOK_CHAR;
+        }
+        else if (kind == TOK_CHAR_LIT && end > off + 1)
+        {
+            tok->value = src[off + 1];
+            if (src[off + 1] == '\n')
+                in->line_num++;
+        }
+
+        off = end;
+        if (kind == TOK_SEMI)
+            break;
     }
-    return value;
+
+    cc->src = in->buf + in->pos;
+    in->pos += off;
+    return count;
 }
 
-// check if line is a var declaration
-int is_declaration(const char *line)
+// source text from the start of tokens[from] to the end of tokens[to - 1]
+// ("" when from == to). The buffer is reused by the next call.
+const char *token_span(Compiler *cc, int from, int to)
 {
-    if (line == NULL)
-        return 0;
-    char *temp = strdup(line);
-    if (temp == NULL)
-        return 0;
-    char *start = temp;
-    while (isspace(*start))
-        start++;
-    char *token = strtok(start, " \t\n");
-    int result = 0;
-    if (token && (strcmp(token, "int") == 0 || strcmp(token, "char") == 0))
+    size_t len = 0;
+    if (from < to)
+        len = cc->tokens[to - 1].start + cc->tokens[to - 1].len - cc->tokens[from].start;
+    if (len + 1 > cc->span_cap)
     {
-        result = 1;
+        size_t new_cap = cc->span_cap ? cc->span_cap : 256;
+        while (new_cap < len + 1)
+            new_cap *= 2;
+        char *grown = (char *)memRealloc(MEM_LEXER, cc->span, new_cap);
+        if (grown == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        cc->span = grown;
+        cc->span_cap = new_cap;
     }
-    free(temp);
-    return result;
+    if (len > 0)
+        memcpy(cc->span, cc->src + cc->tokens[from].start, len);
+    cc->span[len] = '\0';
+    return cc->span;
+}
+
+void free_tokens(Compiler *cc)
+{
+    memFree(cc->tokens);
+    memFree(cc->span);
+    cc->tokens = NULL;
+    cc->span = NULL;
+    cc->token_cap = 0;
+    cc->span_cap = 0;
 }
 
 // --- PEMDAS-COMPLIANT PARSER ---
 
-// gobal helper for the parser
-static const char *g_expr_ptr; // points to the current character in the expression
-static int g_line_num;         // current line number for error reporting
+// next token of the expression, or NULL at its end
+static Token *peek_token(Compiler *cc)
+{
+    return cc->expr_tok < cc->expr_end ? &cc->tokens[cc->expr_tok] : NULL;
+}
 
-// parses an "atom": number, variable, or (parentheses)
-AstNode *parse_atom()
+// parses an "atom": number, char, or variable (parentheses are handled by
+// parse_expression)
+uint32_t parse_atom(Compiler *cc)
 {
-    while (isspace(*g_expr_ptr))
-        g_expr_ptr++;
-    const char *start = g_expr_ptr;
+    Token *tok = peek_token(cc);
 
     // atom: Number (e.g., 5) - positive only
-    if (isdigit(*start))
+    if (tok && tok->kind == TOK_NUMBER)
     {
-        tokCount++;
-        g_expr_ptr++;
-        while (isdigit(*g_expr_ptr))
-        {
-            g_expr_ptr++;
-        }
-        char num_str[32];
-        strncpy(num_str, start, g_expr_ptr - start);
-        num_str[g_expr_ptr - start] = '\0';
-        return create_number_node(atoi(num_str));
+        cc->tokCount++;
+        cc->expr_tok++;
+        return create_number_node(cc, tok->value);
     }
 
     // atom: Char (e.g., 'A')
-    if (*start == '\'')
+    if (tok && tok->kind == TOK_CHAR_LIT)
     {
-        tokCount++;
-        g_expr_ptr++;
-        int char_val = *g_expr_ptr;
-        g_expr_ptr++;
-        if (*g_expr_ptr == '\'')
-            g_expr_ptr++; // Skip closing '
-        return create_number_node(char_val);
+        cc->tokCount++;
+        cc->expr_tok++;
+        return create_number_node(cc, tok->value);
     }
 
-    // atom: Variable (e.g., y)
-    if (isalpha(*start) || *start == '_')
+    // atom: Variable (e.g., y); the type keywords are looked up like any name
+    if (tok && (tok->kind == TOK_IDENT || tok->kind == TOK_INT || tok->kind == TOK_CHAR))
     {
-        tokCount++;
-        g_expr_ptr++;
-        while (isalnum(*g_expr_ptr) || *g_expr_ptr == '_')
-            g_expr_ptr++;
-        char var_name[256];
-        strncpy(var_name, start, g_expr_ptr - start);
-        var_name[g_expr_ptr - start] = '\0';
-
-        if (find_variable(var_name) == NULL)
-        {
-            add_error(g_line_num, ERROR_UNDECLARED, var_name);
-            return create_number_node(0); // Return 0 on error
-        }
-        return create_variable_node(var_name);
-    }
+        cc->tokCount++;
+        cc->expr_tok++;
+        const char *var_name = token_span(cc, cc->expr_tok - 1, cc->expr_tok);
 
-    // atom: Parentheses (e.g., (5 + y))
-    if (*start == '(')
-    {
-        tokCount++;
-        g_expr_ptr++;                       // Consume '('
-        AstNode *node = parse_expression(); // Recursively call the top-level parser
-        if (*g_expr_ptr != ')')
-        {
-            add_error(g_line_num, ERROR_SYNTAX, "Missing ')'");
-        }
-        else
+        int var_index = find_variable_index(cc, var_name);
+        if (var_index < 0)
         {
-            tokCount++;
-            g_expr_ptr++; // Consume ')'
+            add_error(cc, cc->expr_line, ERROR_UNDECLARED, var_name);
+            return create_number_node(cc, 0); // Return 0 on error
         }
-        return node;
+        return create_variable_node(cc, var_index);
     }
 
-    add_error(g_line_num, ERROR_SYNTAX, g_expr_ptr);
-    return create_number_node(0);
+    add_error(cc, cc->expr_line, ERROR_SYNTAX, token_span(cc, cc->expr_tok, cc->expr_end));
+    return create_number_node(cc, 0);
 }
 
-// handles unary + and -
-AstNode *parse_unary()
+// operators waiting on the explicit stack of parse_expression
+typedef enum
 {
-    while (isspace(*g_expr_ptr))
-        g_expr_ptr++;
-    char op = *g_expr_ptr;
-    if (op == '+' || op == '-')
-    {
-        tokCount++; // Count unary op as token
-        g_expr_ptr++;
-        AstNode *operand = parse_unary(); // Recurse for chained unaries like --
-        return create_binary_op_node(op, create_number_node(0), operand);
-    }
-    return parse_atom();
+    PENDING_BINARY,
+    PENDING_UNARY,
+    PENDING_PAREN
+} PendingKind;
+
+typedef struct
+{
+    PendingKind kind;
+    char op;
+} PendingOp;
+
+typedef struct
+{
+    uint32_t *nodes;
+    int node_count;
+    int node_cap;
+    PendingOp *ops;
+    int op_count;
+    int op_cap;
+} ExprStacks;
+
+// unary +/- binds tighter than * and /, which bind tighter than + and -
+static int pending_precedence(PendingOp pending)
+{
+    if (pending.kind == PENDING_UNARY)
+        return 3;
+    return (pending.op == '*' || pending.op == '/') ? 2 : 1;
 }
 
-// handles * and / (high precedence)
-AstNode *parse_term()
+static void push_node(ExprStacks *s, uint32_t node)
 {
-    AstNode *left_node = parse_unary();
+    if (s->node_count == s->node_cap)
+        s->nodes = grow_stack(s->nodes, &s->node_cap, sizeof(uint32_t));
+    s->nodes[s->node_count++] = node;
+}
+
+static void push_pending(ExprStacks *s, PendingKind kind, char op)
+{
+    if (s->op_count == s->op_cap)
+        s->ops = grow_stack(s->ops, &s->op_cap, sizeof(PendingOp));
+    s->ops[s->op_count].kind = kind;
+    s->ops[s->op_count].op = op;
+    s->op_count++;
+}
+
+// pops the top operator and replaces its two operands with one node
+static void reduce_pending(Compiler *cc, ExprStacks *s)
+{
+    PendingOp pending = s->ops[--s->op_count];
+    uint32_t right = s->nodes[--s->node_count];
+    uint32_t left = s->nodes[--s->node_count];
+    s->nodes[s->node_count++] = create_binary_op_node(cc, pending.op, left, right);
+}
+
+// parses + - * /, unary +/- and parentheses with explicit stacks
+// (shunting-yard), so nesting depth and chains like ----x are limited by
+// memory instead of the C stack. Trees, token counts and errors are the
+// same as the expression -> term -> unary -> atom recursive descent.
+uint32_t parse_expression(Compiler *cc)
+{
+    ExprStacks s = {0};
+    int expect_operand = 1;
 
     while (1)
     {
-        while (isspace(*g_expr_ptr))
-            g_expr_ptr++;
-        char op = *g_expr_ptr;
+        Token *tok = peek_token(cc);
+        char c = tok && tok->kind == TOK_OP ? tok->op : 0;
 
-        if (op == '*' || op == '/')
+        if (expect_operand)
         {
-            tokCount++;
-            g_expr_ptr++;
-            AstNode *right_node = parse_unary();
-            left_node = create_binary_op_node(op, left_node, right_node);
+            if (c == '+' || c == '-')
+            {
+                cc->tokCount++; // Count unary op as token
+                cc->expr_tok++;
+                // unary ops are stored as (0 op operand); creating the 0
+                // first keeps ast_nodes in post-order
+                push_node(&s, create_number_node(cc, 0));
+                push_pending(&s, PENDING_UNARY, c);
+            }
+            else if (tok && tok->kind == TOK_LPAREN)
+            {
+                cc->tokCount++;
+                cc->expr_tok++; // Consume '('
+                push_pending(&s, PENDING_PAREN, '(');
+            }
+            else
+            {
+                push_node(&s, parse_atom(cc));
+                expect_operand = 0;
+            }
+            continue;
         }
-        else
+
+        if (c != 0)
         {
-            break;
+            PendingOp incoming = {PENDING_BINARY, c};
+            while (s.op_count > 0 && s.ops[s.op_count - 1].kind != PENDING_PAREN &&
+                   pending_precedence(s.ops[s.op_count - 1]) >= pending_precedence(incoming))
+                reduce_pending(cc, &s);
+            cc->tokCount++;
+            cc->expr_tok++;
+            push_pending(&s, PENDING_BINARY, c);
+            expect_operand = 1;
+            continue;
         }
-    }
-    return left_node;
-}
-
-// handles + and - (lower precedence)
-AstNode *parse_expression()
-{
-    AstNode *left_node = parse_term();
 
-    while (1)
-    {
-        while (isspace(*g_expr_ptr))
-            g_expr_ptr++;
-        char op = *g_expr_ptr;
+        // end of an expression: finish it back to the innermost '('
+        while (s.op_count > 0 && s.ops[s.op_count - 1].kind != PENDING_PAREN)
+            reduce_pending(cc, &s);
+        if (s.op_count == 0)
+            break;
 
-        if (op == '+' || op == '-')
+        s.op_count--; // the '(' now holds one finished node
+        if (!tok || tok->kind != TOK_RPAREN)
         {
-            tokCount++;
-            g_expr_ptr++;
-            AstNode *right_node = parse_term();
-            left_node = create_binary_op_node(op, left_node, right_node);
+            add_error(cc, cc->expr_line, ERROR_SYNTAX, "Missing ')'");
         }
         else
         {
-            break;
+            cc->tokCount++;
+            cc->expr_tok++; // Consume ')'
         }
     }
-    return left_node;
+
+    uint32_t tree = s.nodes[0];
+    memFree(s.nodes);
+    memFree(s.ops);
+    return tree;
 }
 
-// main entry point for the expression parser
-AstNode *parse_expression_to_ast(const char *expression_str, int line_num)
+// main entry point for the expression parser: parses tokens[first, end).
+// The tree is the span of nodes it appended to ast_nodes.
+AstSpan parse_expression_to_ast(Compiler *cc, int first, int end, int line_num)
 {
-    if (expression_str == NULL)
-        return NULL;
-
-    char *temp_expr = strdup(expression_str);
-    char *start = temp_expr;
-    while (isspace(*start))
-        start++;
-    char *end = start + strlen(start) - 1;
-    while (end > start && isspace(*end))
-    {
-        *end = '\0';
-        end--;
-    }
+    AstSpan tree = {cc->ast_node_count, 0};
 
-    g_expr_ptr = start;
-    g_line_num = line_num;
-    AstNode *tree = parse_expression();
+    cc->expr_tok = first;
+    cc->expr_end = end;
+    cc->expr_line = line_num;
+    parse_expression(cc);
+    tree.count = cc->ast_node_count - tree.first;
 
-    while (isspace(*g_expr_ptr))
-        g_expr_ptr++;
-    if (*g_expr_ptr != '\0')
+    if (cc->expr_tok < end)
     {
-        add_error(line_num, ERROR_SYNTAX, g_expr_ptr);
+        add_error(cc, line_num, ERROR_SYNTAX, token_span(cc, cc->expr_tok, end));
     }
-
-    free(temp_expr);
     return tree;
 }
 
-// ---  process a variable declaration line ---
-void process_declaration(const char *declaration, int line_num)
+// --- process one statement, tokens[0, count) ---
+void process_statement(Compiler *cc, int count, int line_num)
 {
-    if (declaration == NULL)
+    // Check if this individual statement has a semicolon
+    if (cc->tokens[count - 1].kind != TOK_SEMI)
+    {
+        add_error(cc, line_num, ERROR_SYNTAX, "Missing semicolon");
         return;
+    }
 
-    char *line_copy = strdup(declaration);
-    char *data_type_str = extract_data_type(line_copy);
-    if (!data_type_str)
+    // skip completely empty statements (just semicolons)
+    if (count == 1)
     {
-        add_error(line_num, ERROR_SYNTAX, "Missing data type");
-        free(line_copy);
+        cc->tokCount++; // Count the semicolon token
         return;
     }
-    tokCount++; // for data type
-    int data_type = (strcmp(data_type_str, "int") == 0) ? TYPE_INT : TYPE_CHAR;
-    char *var_list_start = line_copy + strlen(data_type_str);
-    while (isspace(*var_list_start))
-        var_list_start++;
-    char *semicolon = strrchr(var_list_start, ';');
-    if (semicolon)
-        *semicolon = '\0';
-    char *var_decl = strtok(var_list_start, ",");
-
-    while (var_decl != NULL)
+
+    // === CASE 1: Declaration (starts with int or char) ===
+    if (cc->tokens[0].kind == TOK_INT || cc->tokens[0].kind == TOK_CHAR)
     {
-        char *var_name = var_decl;
-        char *value_str = NULL;
-        AstNode *tree = NULL;
+        process_declaration(cc, count, line_num);
+        return;
+    }
 
-        char *equals = strchr(var_name, '=');
-        if (equals)
+    // === CASE 2: Assignment (has = and left side is identifier) ===
+    for (int i = 0; i < count; i++)
+    {
+        if (cc->tokens[i].kind == TOK_ASSIGN)
         {
-            tokCount++; // for =
-            *equals = '\0';
-            value_str = equals + 1;
+            // if left side is a valid identifier then it is an assignment line
+            if (cc->tokens[0].kind == TOK_IDENT)
+                process_assignment(cc, count, i, line_num);
+            return;
         }
+    }
 
-        char *name_end = var_name + strlen(var_name) - 1;
-        while (name_end > var_name && isspace(*name_end))
-        {
-            *name_end = '\0';
-            name_end--;
-        }
-        while (isspace(*var_name))
-            var_name++;
-        tokCount++; // for var_name
+    // === CASE 3: Pure expression (no =) then evaluate and store in temp ===
+    cc->tokCount++; // Count the semicolon
+    AstSpan expr_tree = parse_expression_to_ast(cc, 0, count - 1, line_num);
+
+    // create a temporary variable name for the result
+    char temp_var[32];
+    sprintf(temp_var, "__temp_%d", line_num);
+
+    // add temporary variable to symbol table
+    if (add_variable(cc, temp_var, TYPE_INT, line_num))
+    {
+        // add to history as a special "EXPRESSION" type assignment
+        add_history_entry(cc, line_num, OP_ASSIGNMENT, cc->symbol_count - 1, TYPE_INT, expr_tree, token_span(cc, 0, count));
+    }
+}
 
-        if (add_variable(var_name, data_type, line_num))
+// ---  process a variable declaration: type name [= expr], ... ; ---
+void process_declaration(Compiler *cc, int count, int line_num)
+{
+    // if nothing after data type, it's an error
+    if (count == 2)
+    {
+        add_error(cc, line_num, ERROR_SYNTAX, "Data type without variable name");
+        return;
+    }
+    cc->tokCount++; // for data type
+    int data_type = cc->tokens[0].kind == TOK_INT ? TYPE_INT : TYPE_CHAR;
+
+    int decl_start = 1;
+    while (decl_start < count - 1)
+    {
+        int decl_end = decl_start;
+        while (decl_end < count - 1 && cc->tokens[decl_end].kind != TOK_COMMA)
+            decl_end++;
+        int equals = decl_start;
+        while (equals < decl_end && cc->tokens[equals].kind != TOK_ASSIGN)
+            equals++;
+
+        if (decl_end > decl_start)
         {
-            // printf("  -> Variable '%s' declared as %s\n", var_name, data_type_str);
-            if (value_str)
+            if (equals < decl_end)
+                cc->tokCount++; // for =
+            cc->tokCount++;     // for var_name
+
+            if (add_variable(cc, token_span(cc, decl_start, equals), data_type, line_num))
             {
-                // Parse the expression into an AST
-                tree = parse_expression_to_ast(value_str, line_num);
-                // printf("  -> Parsed expression for '%s'\n", var_name);
+                int var_index = cc->symbol_count - 1;
+                AstSpan tree = {0, 0};
+                if (equals < decl_end)
+                {
+                    // Parse the expression into an AST
+                    tree = parse_expression_to_ast(cc, equals + 1, decl_end, line_num);
+                }
+                add_history_entry(cc, line_num, OP_DECLARATION, var_index, data_type, tree, token_span(cc, 0, count));
             }
-            add_history_entry(line_num, OP_DECLARATION, var_name, data_type, tree, declaration);
         }
-        var_decl = strtok(NULL, ",");
+        decl_start = decl_end + 1;
     }
-    free(line_copy);
-    free(data_type_str);
 }
 
-// --- process a variable assignment line ---
-void process_assignment(const char *assignment, int line_num)
+// --- process a variable assignment: name = expr ; ---
+void process_assignment(Compiler *cc, int count, int equals, int line_num)
 {
-    if (assignment == NULL)
+    // the name runs until the first space, '=' or ','
+    int name_end = 1;
+    while (name_end < equals && cc->tokens[name_end].kind != TOK_COMMA &&
+           cc->tokens[name_end].start == cc->tokens[name_end - 1].start + cc->tokens[name_end - 1].len)
+        name_end++;
+
+    int var_index = find_variable_index(cc, token_span(cc, 0, name_end));
+    if (var_index < 0)
+    {
+        add_error(cc, line_num, ERROR_UNDECLARED, token_span(cc, 0, count));
         return;
-    char *var_name = extract_variable_name(assignment);
-    char *value = extract_value(assignment);
-    AstNode *tree = NULL;
+    }
+    cc->tokCount++; // for var_name
+    cc->tokCount++; // for =
 
-    if (var_name)
+    AstSpan tree = {0, 0};
+    if (equals + 1 < count - 1)
     {
-        vars *var = find_variable(var_name);
-        if (var == NULL)
-        {
-            add_error(line_num, ERROR_UNDECLARED, assignment);
-            free(var_name);
-            if (value)
-                free(value);
-            return;
-        }
-        tokCount++; // for var_name
-        tokCount++; // for =
-        // printf("  -> Reassigning variable '%s'\n", var_name);
-        if (value)
-        {
-            // Parse the expression into an AST
-            tree = parse_expression_to_ast(value, line_num);
-            // printf("  -> Parsed expression for '%s'\n", var_name);
-        }
-        add_history_entry(line_num, OP_ASSIGNMENT, var_name, var->data_type, tree, assignment);
+        // Parse the expression into an AST
+        tree = parse_expression_to_ast(cc, equals + 1, count - 1, line_num);
     }
-    if (var_name)
-        free(var_name);
-    if (value)
-        free(value);
+    add_history_entry(cc, line_num, OP_ASSIGNMENT, var_index, cc->symbol_table[var_index].data_type, tree, token_span(cc, 0, count));
 }
 
 // PRINT symbol table content
-void print_symbol_table()
+void print_symbol_table(Compiler *cc)
 {
-    if (symbol_table == NULL)
+    if (cc->symbol_count == 0)
     {
         printf("\n=== Symbol Table ===\n(empty)\n\n");
         return;
@@ -684,23 +1037,23 @@ void print_symbol_table()
     printf("\n=== Symbol Table ===\n");
     printf("%-15s %-10s %-10s\n", "Variable", "Type", "Register");
     printf("------------------------------------------------------------\n");
-    vars *current = symbol_table;
-    while (current != NULL)
+    // newest declaration first
+    for (int i = cc->symbol_count - 1; i >= 0; i--)
     {
+        vars *current = &cc->symbol_table[i];
         printf("%-15s ", current->id);
         printf("%-10s ", current->data_type == TYPE_INT ? "int" : "char");
         printf("r%-9d ", current->reg_num);
 
         printf("\n");
-        current = current->next;
     }
     printf("\n");
 }
 
 // prints error lists
-void print_errors()
+void print_errors(Compiler *cc)
 {
-    if (error_list_head == NULL)
+    if (cc->error_list_head == NULL)
     {
         printf("\n=== No Errors Found ===\n\n");
         return;
@@ -708,7 +1061,7 @@ void print_errors()
     printf("\n=== Error List ===\n");
     printf("%-10s %-30s %s\n", "Line", "Error Type", "Details");
     printf("-------------------------------------------------------------------------\n");
-    errorList *current = error_list_head;
+    errorList *current = cc->error_list_head;
     while (current != NULL)
     {
         printf("%-10d %-30s", current->line_error, current->error_type);
@@ -722,36 +1075,63 @@ void print_errors()
     printf("\n");
 }
 
-// helper to print the AST for debugging
-void print_history_ast(AstNode *node)
+// helper to print the AST for debugging, walking it with an explicit stack
+void print_history_ast(Compiler *cc, AstSpan tree)
 {
-    if (!node)
+    if (tree.count == 0)
     {
         printf("(uninitialized)");
         return;
     }
-    switch (node->type)
+
+    AstFrame *stack = NULL;
+    int count = 0, cap = 0;
+    push_frame(&stack, &count, &cap, tree.first + tree.count - 1);
+
+    while (count > 0)
     {
-    case NODE_NUMBER:
-        printf("%d", node->value);
-        break;
-    case NODE_VARIABLE:
-        printf("%s", node->var_name);
-        break;
-    case NODE_BINARY_OP:
-        printf("(");
-        print_history_ast(node->op_details.left);
-        printf(" %c ", node->op_details.op);
-        print_history_ast(node->op_details.right);
-        printf(")");
-        break;
+        AstFrame *top = &stack[count - 1];
+        uint32_t index = top->node;
+        AstNode *cur = &cc->ast_nodes[index];
+        switch (cur->type)
+        {
+        case NODE_NUMBER:
+            printf("%d", cur->value);
+            count--;
+            break;
+        case NODE_VARIABLE:
+            printf("%s", cc->symbol_table[cur->var].id);
+            count--;
+            break;
+        case NODE_BINARY_OP:
+            // set the stage first: pushing may move the stack
+            if (top->stage == 0)
+            {
+                printf("(");
+                top->stage = 1;
+                push_frame(&stack, &count, &cap, cur->left);
+            }
+            else if (top->stage == 1)
+            {
+                printf(" %c ", cur->op);
+                top->stage = 2;
+                push_frame(&stack, &count, &cap, index - 1);
+            }
+            else
+            {
+                printf(")");
+                count--;
+            }
+            break;
+        }
     }
+    memFree(stack);
 }
 
 // prints the operation history with ast
-void print_history()
+void print_history(Compiler *cc)
 {
-    if (history_head == NULL)
+    if (cc->history_head == NULL)
     {
         printf("\n=== Operation History ===\n(empty)\n\n");
         return;
@@ -759,14 +1139,14 @@ void print_history()
     printf("\n=== Operation History (AST View) ===\n");
     printf("%-6s %-15s %-12s %-10s %-20s\n", "Line", "Operation", "Variable", "Type", "Expression Blueprint");
     printf("--------------------------------------------------------------------------\n");
-    history *current = history_head;
+    history *current = cc->history_head;
     while (current != NULL)
     {
         printf("%-6d ", current->line_num);
         printf("%-15s ", (current->operation_type == OP_DECLARATION) ? "DECLARE" : "ASSIGN");
         printf("%-12s ", current->variable_name);
         printf("%-10s ", current->data_type == TYPE_INT ? "int" : "char");
-        print_history_ast(current->expression_tree);
+        print_history_ast(cc, current->expression_tree);
         printf("\n");
         current = current->next;
     }
@@ -775,86 +1155,89 @@ void print_history()
 
 // ---  generate_mips64 ---
 
-// recursive function walks the AST and generates MIPS code THEN returns the temporary register number that holds the final result.
-int generate_mips_for_ast(FILE *output_file, AstNode *node)
+// walks the post-order nodes of the AST front to back and generates MIPS code THEN returns the temporary register number that holds the final result.
+// A subtree started with next_temp_register == k always leaves its result in
+// rk, so the operands of a binary node are the two most recent registers.
+int generate_mips_for_ast(Compiler *cc, FILE *output_file, AstSpan tree)
 {
-    if (!node)
+    if (tree.count == 0)
         return 0; // should not happen (error)
 
     int reg_num;
-    switch (node->type)
+    for (uint32_t i = tree.first; i < tree.first + tree.count; i++)
     {
-    case NODE_NUMBER:
-        // load an immediate value into a new temporary register
-        reg_num = next_temp_register++;
-        fprintf(output_file, "    daddiu r%d, r0, %d\n", reg_num, node->value);
-        return reg_num;
-
-    case NODE_VARIABLE:
-        // load the variable's value from memory into a new temporary register
-        reg_num = next_temp_register++;
-        vars *var = find_variable(node->var_name);
-        if (var->data_type == TYPE_INT)
+        AstNode *cur = &cc->ast_nodes[i];
+        switch (cur->type)
         {
-            fprintf(output_file, "    ld r%d, %s(r0)\n", reg_num, var->id);
-        }
-        else
-        {
-            fprintf(output_file, "    lb r%d, %s(r0)\n", reg_num, var->id);
-        }
-        return reg_num;
-
-    case NODE_BINARY_OP:
-    {
-        // 1. generate code for the left side
-        int left_reg = generate_mips_for_ast(output_file, node->op_details.left);
-        // 2. generate code for the right side
-        int right_reg = generate_mips_for_ast(output_file, node->op_details.right);
+        case NODE_NUMBER:
+            // load an immediate value into a new temporary register
+            reg_num = cc->next_temp_register++;
+            fprintf(output_file, "    daddiu r%d, r0, %d\n", reg_num, cur->value);
+            break;
 
-        // 3. `left_reg` now holds the result of the left side.
-        //    `right_reg` holds the result of the right side.
-        //    re-use `left_reg` for the final result.
+        case NODE_VARIABLE:
+            // load the variable's value from memory into a new temporary register
+            reg_num = cc->next_temp_register++;
+            vars *var = &cc->symbol_table[cur->var];
+            if (var->data_type == TYPE_INT)
+            {
+                fprintf(output_file, "    ld r%d, %s(r0)\n", reg_num, var->id);
+            }
+            else
+            {
+                fprintf(output_file, "    lb r%d, %s(r0)\n", reg_num, var->id);
+            }
+            break;
 
-        switch (node->op_details.op)
+        case NODE_BINARY_OP:
         {
-        case '+':
-            // DADDU rd, rs, rt (rd = rs + rt)
-            fprintf(output_file, "    daddu r%d, r%d, r%d\n", left_reg, left_reg, right_reg);
-            break;
-        case '-':
-            // DSUBU rd, rs, rt (rd = rs - rt)
-            fprintf(output_file, "    dsubu r%d, r%d, r%d\n", left_reg, left_reg, right_reg);
-            break;
-        case '*':
-            // use HI/LO registers for dmul
-            fprintf(output_file, "    dmult r%d, r%d\n", left_reg, right_reg);
-            fprintf(output_file, "    mflo r%d\n", left_reg); // Move result from LO to left_reg
-            break;
-        case '/':
-            // Use  HI/LO registers for ddiv
-            fprintf(output_file, "    ddiv r%d, r%d\n", left_reg, right_reg);
-            fprintf(output_file, "    mflo r%d\n", left_reg); // Move quotient from LO to left_reg
+            // `left_reg` holds the result of the left side.
+            // `right_reg` holds the result of the right side.
+            // re-use `left_reg` for the final result.
+            int left_reg = cc->next_temp_register - 2;
+            int right_reg = cc->next_temp_register - 1;
+
+            switch (cur->op)
+            {
+            case '+':
+                // DADDU rd, rs, rt (rd = rs + rt)
+                fprintf(output_file, "    daddu r%d, r%d, r%d\n", left_reg, left_reg, right_reg);
+                break;
+            case '-':
+                // DSUBU rd, rs, rt (rd = rs - rt)
+                fprintf(output_file, "    dsubu r%d, r%d, r%d\n", left_reg, left_reg, right_reg);
+                break;
+            case '*':
+                // use HI/LO registers for dmul
+                fprintf(output_file, "    dmult r%d, r%d\n", left_reg, right_reg);
+                fprintf(output_file, "    mflo r%d\n", left_reg); // Move result from LO to left_reg
+                break;
+            case '/':
+                // Use  HI/LO registers for ddiv
+                fprintf(output_file, "    ddiv r%d, r%d\n", left_reg, right_reg);
+                fprintf(output_file, "    mflo r%d\n", left_reg); // Move quotient from LO to left_reg
+                break;
+            }
+
+            // result is now in left_reg.  free right_reg for later use.
+            cc->next_temp_register--; // Frees right_reg
             break;
         }
-
-        // result is now in left_reg.  free right_reg for later use.
-        next_temp_register--; // Frees right_reg
-        return left_reg;      // Return the register that holds the result
-    }
+        }
     }
-    return 0;
+    return cc->next_temp_register - 1; // the root's register
 }
 
 // generate complete mips64 assembly code from history
-void generate_mips64()
+void generate_mips64(Compiler *cc, char *filename)
 {
-    FILE *output_file = fopen("output.txt", "w");
+    FILE *output_file = fopen(filename, "w");
     if (!output_file)
     {
-        printf("Error: Could not create output.txt file\n");
+        printf("Error: Could not create %s file\n", filename);
         return;
     }
-    if (!history_head)
+    if (!cc->history_head)
     {
         fclose(output_file);
         return;
@@ -865,13 +1248,13 @@ void generate_mips64()
     fprintf(output_file, ".data\n");
     // printf(".data\n");
 
-    vars *cur_var = symbol_table;
-    while (cur_var)
+    // newest declaration first, like the symbol table listing
+    for (int i = cc->symbol_count - 1; i >= 0; i--)
     {
+        vars *cur_var = &cc->symbol_table[i];
         // Skip temporary variables in .data section
-        if (strncmp(cur_var->id, "__temp_", 7) == 0)
+        if (cur_var->is_temp)
         {
-            cur_var = cur_var->next;
             continue;
         }
 
@@ -885,7 +1268,6 @@ void generate_mips64()
             fprintf(output_file, "%s: .space 1\n", cur_var->id);
             // printf("%s: .space 1\n", cur_var->id);
         }
-        cur_var = cur_var->next;
     }
 
     fprintf(output_file, "\n.text\n");
@@ -893,28 +1275,23 @@ void generate_mips64()
     fprintf(output_file, "main:\n");
     // printf("main:\n");
 
-    history *current = history_head;
+    history *current = cc->history_head;
     while (current)
     {
-        vars *dst = find_variable(current->variable_name);
-        if (!dst)
-        {
-            current = current->next;
-            continue;
-        }
+        vars *dst = &cc->symbol_table[current->var_index];
 
         // only generate code if there is an expression
-        if (current->expression_tree)
+        if (current->expression_tree.count > 0)
         {
             // reset the temporary register counter for each new statement
-            next_temp_register = 8;
+            cc->next_temp_register = 8;
 
             // generate all the MIPS for the expression
             // the final result will be in the register returned by this call
-            int final_result_reg = generate_mips_for_ast(output_file, current->expression_tree);
+            int final_result_reg = generate_mips_for_ast(cc, output_file, current->expression_tree);
 
             // Only store result if it's NOT a temporary variable
-            if (strncmp(current->variable_name, "__temp_", 7) != 0)
+            if (!dst->is_temp)
             {
                 // store final result from the temp reg into the variable's memory
                 if (dst->data_type == TYPE_INT)
@@ -942,69 +1319,78 @@ void generate_mips64()
 }
 
 // free symbol table memory
-void free_symbol_table()
+void free_symbol_table(Compiler *cc)
 {
-    vars *current = symbol_table;
-    while (current != NULL)
+    for (int i = 0; i < cc->symbol_count; i++)
     {
-        vars *temp = current;
-        current = current->next;
-        if (temp->id != NULL)
-        {
-            free(temp->id);
-        }
-        free(temp);
+        memFree(cc->symbol_table[i].id);
     }
-    symbol_table = NULL;
+    memFree(cc->symbol_table);
+    memFree(cc->symbol_index);
+    cc->symbol_table = NULL;
+    cc->symbol_index = NULL;
+    cc->symbol_count = cc->symbol_cap = 0;
+    cc->symbol_index_cap = 0;
 }
 
 // free error list memory
-void free_error_list()
+void free_error_list(Compiler *cc)
 {
-    errorList *current = error_list_head;
+    errorList *current = cc->error_list_head;
     while (current != NULL)
     {
         errorList *temp = current;
         current = current->next;
         if (temp->error_type != NULL)
         {
-            free(temp->error_type);
+            memFree(temp->error_type);
         }
         if (temp->line_content != NULL)
         {
-            free(temp->line_content);
+            memFree(temp->line_content);
         }
-        free(temp);
+        memFree(temp);
     }
-    error_list_head = NULL;
+    cc->error_list_head = NULL;
 }
 
 // free history memory
-void free_history()
+void free_history(Compiler *cc)
 {
-    history *current = history_head;
+    history *current = cc->history_head;
     while (current != NULL)
     {
         history *temp = current;
         current = current->next;
 
-        if (temp->variable_name != NULL)
-        {
-            free(temp->variable_name);
-        }
-        // --- NEW: Free the AST ---
-        if (temp->expression_tree != NULL)
-        {
-            free_ast(temp->expression_tree);
-        }
         if (temp->original_line != NULL)
         {
-            free(temp->original_line);
+            memFree(temp->original_line);
         }
-        free(temp);
+        memFree(temp);
     }
-    history_head = NULL;
-    history_tail = NULL;
+    cc->history_head = NULL;
+    cc->history_tail = NULL;
+
+    // the trees are gone with their history entries
+    free_ast_nodes(cc);
+}
+
+// --- Stage Timing ---
+
+// monotonic seconds, for timing the stages of main
+double stage_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// with SPYC_STAGE_TIMES set, prints "stage <name> <seconds>" to stderr
+void report_stage(const char *stage, double started)
+{
+    if (getenv("SPYC_STAGE_TIMES"))
+        fprintf(stderr, "stage %s %.6f\n", stage, stage_clock() - started);
 }
 
 // (binhex converter functions are unchanged)
@@ -1089,7 +1475,7 @@ void print_binary_fields(uint32_t binary, const char *format_type)
 }
 
 // convert mips to binary and hex
-void convert_mips64_to_binhex(char *filename)
+void convert_mips64_to_binhex(Compiler *cc, char *filename)
 {
     FILE *file = fopen(filename, "r");
     if (!file)
@@ -1131,12 +1517,13 @@ void convert_mips64_to_binhex(char *filename)
         if (strcmp(instr_only, "ld") == 0 || strcmp(instr_only, "sd") == 0 ||
             strcmp(instr_only, "lb") == 0 || strcmp(instr_only, "sb") == 0)
         {
-            char *rt_str = strtok(trimmed + strlen(instr_only), " \t,");
-            char *addr_str = strtok(NULL, "");
+            char *save;
+            char *rt_str = strtok_r(trimmed + strlen(instr_only), " \t,", &save);
+            char *addr_str = strtok_r(NULL, "", &save);
             if (rt_str && addr_str && strchr(addr_str, '('))
             {
-                char *label_str = strtok(addr_str, "(");
-                char *rs_str = strtok(NULL, ")");
+                char *label_str = strtok_r(addr_str, "(", &save);
+                char *rs_str = strtok_r(NULL, ")", &save);
                 if (label_str && rs_str)
                 {
                     int rt_num = get_register_number(rt_str);
@@ -1303,18 +1690,44 @@ void convert_mips64_to_binhex(char *filename)
         printf("| %-2d | %-22s | ", instr_count, trimmed);
         print_binary_fields(binary, format_type);
         printf(" | 0x%08X |\n", binary);
-        instructions[total_instrs] = binary;
-        strcpy(formats[total_instrs], format_type);
-        total_instrs++;
+        if (total_instrs < 1024)
+        {
+            instructions[total_instrs] = binary;
+            strcpy(formats[total_instrs], format_type);
+            total_instrs++;
+        }
         instr_count++;
     }
     printf("+----+------------------------+-------------------------------------------+----------+\n");
-    printf("\nTOKEN COUNT: %d\n", tokCount);
+    printf("\nTOKEN COUNT: %d\n", cc->tokCount);
     fclose(file);
 }
 
+// --- Compiler Context ---
+
+// a fresh compilation; NULL when out of memory
+Compiler *create_compiler()
+{
+    Compiler *cc = (Compiler *)memCalloc(MEM_SYMTAB, 1, sizeof(Compiler));
+    if (cc == NULL)
+        return NULL;
+    cc->next_register = 1;
+    cc->next_temp_register = 8;
+    return cc;
+}
+
+void free_compiler(Compiler *cc)
+{
+    free_symbol_table(cc);
+    free_error_list(cc);
+    free_history(cc);
+    free_tokens(cc);
+    memFree(cc);
+}
+
 int main()
 {
+    memReportAtExit();
     FILE *file = fopen("input.txt", "r");
     if (file == NULL)
     {
@@ -1322,225 +1735,46 @@ int main()
         return 1;
     }
 
-    char line[2048];
-    int line_num = 1;
-
-    while (fgets(line, sizeof(line), file) != NULL)
+    Compiler *cc = create_compiler();
+    if (cc == NULL)
     {
-        // remove newline
-        line[strcspn(line, "\n")] = 0;
-
-        char *input = line;
-
-        while (*input)
-        {
-            // skip whitespace
-            while (isspace(*input))
-                input++;
-            if (*input == '\0')
-                break;
-
-            // find next semicolon
-            char *semicolon = strchr(input, ';');
-            char stmt[1024];
-
-            if (!semicolon)
-            {
-                strncpy(stmt, input, sizeof(stmt) - 1);
-                stmt[sizeof(stmt) - 1] = '\0';
-                input += strlen(input);
-            }
-            else
-            {
-                size_t len = semicolon - input + 1;
-                if (len >= sizeof(stmt))
-                    len = sizeof(stmt) - 1;
-                strncpy(stmt, input, len);
-                stmt[len] = '\0';
-                input = semicolon + 1;
-            }
-
-            // trim trailing whitespace
-            char *end = stmt + strlen(stmt) - 1;
-            while (end >= stmt && isspace(*end))
-                *end-- = '\0';
-
-            // skip empty statements
-            char *start = stmt;
-            while (isspace(*start))
-                start++;
-            if (*start == '\0')
-                continue;
-
-            char temp[1024];
-            strcpy(temp, stmt);
-
-            // Check if this individual statement has a semicolon
-            if (strchr(temp, ';') == NULL)
-            {
-                add_error(line_num, ERROR_SYNTAX, "Missing semicolon");
-                continue; // Skip this statement
-            }
-
-            // remove semicolon and trim for checking if statement is empty
-            char check_empty[1024];
-            strcpy(check_empty, temp);
-            char *semi = strchr(check_empty, ';');
-            if (semi)
-                *semi = '\0';
-
-            // Trim whitespace
-            char *check_ptr = check_empty;
-            while (isspace(*check_ptr))
-                check_ptr++;
-            char *check_end = check_ptr + strlen(check_ptr) - 1;
-            while (check_end > check_ptr && isspace(*check_end))
-                *check_end-- = '\0';
-
-            // skip completely empty statements (just semicolons)
-            if (*check_ptr == '\0')
-            {
-                tokCount++; // Count the semicolon token
-                continue;
-            }
-
-            // === CASE 1: Declaration (starts with int or char) ===
-            if (is_declaration(temp))
-            {
-                // check if there's actually a variable name after the data type
-                char *temp_copy = strdup(temp);
-                char *data_type_str = extract_data_type(temp_copy);
-
-                if (data_type_str)
-                {
-                    // check if there's anything after the data type
-                    char *after_type = temp_copy + strlen(data_type_str);
-                    while (isspace(*after_type))
-                        after_type++;
-
-                    // remove semicolons and whitespace to check if empty
-                    char check_var[1024];
-                    strcpy(check_var, after_type);
-                    char *sc = strchr(check_var, ';');
-                    if (sc)
-                        *sc = '\0';
-
-                    // trim
-                    char *cv_ptr = check_var;
-                    while (isspace(*cv_ptr))
-                        cv_ptr++;
-                    char *cv_end = cv_ptr + strlen(cv_ptr) - 1;
-                    while (cv_end > cv_ptr && isspace(*cv_end))
-                        *cv_end-- = '\0';
-
-                    // if nothing after data type, it's an error
-                    if (*cv_ptr == '\0')
-                    {
-                        add_error(line_num, ERROR_SYNTAX, "Data type without variable name");
-                        free(data_type_str);
-                        free(temp_copy);
-                    }
-                    else
-                    {
-                        free(data_type_str);
-                        free(temp_copy);
-                        process_declaration(temp, line_num);
-                    }
-                }
-                else
-                {
-                    free(temp_copy);
-                    process_declaration(temp, line_num);
-                }
-            }
-            // === CASE 2: Assignment (has = and left side is identifier) ===
-            else if (strchr(temp, '=') != NULL)
-            {
-                char *eq = strchr(temp, '=');
-                char lhs[256] = {0};
-                strncpy(lhs, temp, eq - temp);
-                lhs[eq - temp] = '\0';
-
-                // trim lhs
-                char *p = lhs;
-                while (isspace(*p))
-                    p++;
-                char *q = p + strlen(p) - 1;
-                while (q > p && isspace(*q))
-                    *q-- = '\0';
-
-                // if left side is a valid identifier then it is an assignment line
-                if (isalpha(p[0]) || p[0] == '_')
-                {
-                    process_assignment(temp, line_num);
-                }
-            }
-            // === CASE 3: Pure expression (no =) then evaluate and store in temp ===
-            else
-            {
-                // remove semicolon before parsing
-                char expr_str[1024];
-                strcpy(expr_str, temp);
-                char *semicolon_pos = strchr(expr_str, ';');
-                if (semicolon_pos)
-                {
-                    tokCount++; // Count the semicolon
-                    *semicolon_pos = '\0';
-                }
-
-                // trim any trailing whitespace
-                char *trim_end = expr_str + strlen(expr_str) - 1;
-                while (trim_end > expr_str && isspace(*trim_end))
-                {
-                    *trim_end = '\0';
-                    trim_end--;
-                }
-
-                // Skip if expression is empty after removing semicolon
-                char *expr_start = expr_str;
-                while (isspace(*expr_start))
-                    expr_start++;
-
-                if (*expr_start == '\0')
-                    continue;
-
-                // parse the expression to build AST
-                AstNode *expr_tree = parse_expression_to_ast(expr_start, line_num);
+        fprintf(stderr, "Memory allocation failed\n");
+        fclose(file);
+        return 1;
+    }
 
-                if (expr_tree != NULL)
-                {
-                    // create a temporary variable name for the result
-                    char temp_var[32];
-                    sprintf(temp_var, "__temp_%d", line_num);
+    SourceReader source = {0};
+    source.file = file;
+    source.line_num = 1;
+    double stage_start = stage_clock();
 
-                    // add temporary variable to symbol table
-                    if (add_variable(temp_var, TYPE_INT, line_num))
-                    {
-                        // add to history as a special "EXPRESSION" type assignment
-                        add_history_entry(line_num, OP_ASSIGNMENT, temp_var, TYPE_INT, expr_tree, temp);
-                    }
-                }
-            }
-        }
-        line_num++;
+    // compile the program one statement at a time
+    int count, line_num = 1;
+    while ((count = tokenize_statement(cc, &source, &line_num)) > 0)
+    {
+        process_statement(cc, count, line_num);
     }
 
-    fclose(file);
+    close_source(&source);
+    report_stage("front_end", stage_start);
 
-    print_symbol_table();
-    print_history();
+    print_symbol_table(cc);
+    print_history(cc);
 
-    if (error_list_head == NULL)
+    if (cc->error_list_head == NULL)
     {
-        generate_mips64();
-        convert_mips64_to_binhex("output.txt");
+        stage_start = stage_clock();
+        generate_mips64(cc, "output.txt");
+        report_stage("generate_mips64", stage_start);
+
+        stage_start = stage_clock();
+        convert_mips64_to_binhex(cc, "output.txt");
+        report_stage("convert_mips64_to_binhex", stage_start);
     }
 
-    print_errors();
+    print_errors(cc);
 
-    free_symbol_table();
-    free_error_list();
-    free_history();
+    free_compiler(cc);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+// Shared allocation layer with per-subsystem accounting for the interpreter
+// (parser.y, lexer.l), the MIPS64 front end (parser/test.c) and the validator
+// (parser/MS/a.c).
+//
+// Every block carries a small header recording its size and subsystem, so
+// memFree() needs no extra arguments and live bytes stay exact. Counters are
+// atomic because spyc-batch allocates from several threads.
+//
+// Define SPYC_MEM_IMPLEMENTATION in exactly one translation unit of a program
+// before including this file. Set SPYC_MEMSTATS in the environment to have
+// memReportAtExit() print allocation counts, live bytes and peak bytes per
+// subsystem to stderr when the program exits.
+
+#ifndef SPYC_MEM_H
+#define SPYC_MEM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+    MEM_LEXER,       // input buffers, token and line copies
+    MEM_SYMTAB,      // names, variable records, string values
+    MEM_AST,         // syntax trees and parse-time values
+    MEM_HISTORY,     // statement history
+    MEM_DIAG,        // error lists and profiling data
+    MEM_CODEGEN,     // bytecode, emitted code
+    MEM_OUTPUT,      // output buffering
+    MEM_DRIVER,      // spyc-batch job list and worker pool
+    MEM_OTHER,       // invalid subsystem ids, reported rather than hidden
+    MEM_SUBSYSTEMS
+} memSubsystem;
+
+void* memAlloc(int sys, size_t size);
+void* memCalloc(int sys, size_t count, size_t size);
+void* memRealloc(int sys, void *ptr, size_t size);
+char* memStrdup(int sys, const char *text);
+void memFree(void *ptr);
+
+void memReport(FILE *out);
+void memReportAtExit(void);
+
+#endif
+
+#ifdef SPYC_MEM_IMPLEMENTATION
+#undef SPYC_MEM_IMPLEMENTATION
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+// 16 bytes keeps the payload as aligned as malloc's own result
+typedef struct memHeader {
+    size_t size;
+    size_t sys;
+} memHeader;
+
+typedef struct memCounters {
+    atomic_size_t allocs;
+    atomic_size_t frees;
+    atomic_size_t live;
+    atomic_size_t peak;
+} memCounters;
+
+static memCounters memStats[MEM_SUBSYSTEMS];
+static memCounters memTotal;
+
+static const char *memNames[MEM_SUBSYSTEMS] = {
+    "lexer", "symtab", "ast", "history", "diagnostics", "codegen", "output", "driver", "other",
+};
+
+static void memRaisePeak(atomic_size_t *peak, size_t live) {
+    size_t seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (live > seen && !atomic_compare_exchange_weak_explicit(peak, &seen, live,
+                                                                 memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+static void memCount(memCounters *c, size_t added, size_t removed, int isAlloc, int isFree) {
+    if (isAlloc) atomic_fetch_add_explicit(&c->allocs, 1, memory_order_relaxed);
+    if (isFree) atomic_fetch_add_explicit(&c->frees, 1, memory_order_relaxed);
+    size_t live = atomic_fetch_add_explicit(&c->live, added, memory_order_relaxed) + added;
+    if (removed) live = atomic_fetch_sub_explicit(&c->live, removed, memory_order_relaxed) - removed;
+    memRaisePeak(&c->peak, live);
+}
+
+static void memTrack(int sys, size_t added, size_t removed, int isAlloc, int isFree) {
+    if (sys < 0 || sys >= MEM_OTHER) sys = MEM_OTHER;
+    memCount(&memStats[sys], added, removed, isAlloc, isFree);
+    memCount(&memTotal, added, removed, isAlloc, isFree);
+}
+
+void* memAlloc(int sys, size_t size) {
+    // A bad id is a caller bug; release builds count it under "other"
+    assert(sys >= 0 && sys < MEM_OTHER);
+    memHeader *h = malloc(sizeof(memHeader) + size);
+    if (!h) return NULL;
+    h->size = size;
+    h->sys = (size_t)sys;
+    memTrack(sys, size, 0, 1, 0);
+    return h + 1;
+}
+
+void* memCalloc(int sys, size_t count, size_t size) {
+    if (size && count > ((size_t)-1 - sizeof(memHeader)) / size) return NULL;
+    void *p = memAlloc(sys, count * size);
+    if (p) memset(p, 0, count * size);
+    return p;
+}
+
+void* memRealloc(int sys, void *ptr, size_t size) {
+    if (!ptr) return memAlloc(sys, size);
+    memHeader *old = (memHeader *)ptr - 1;
+    size_t oldSize = old->size;
+    memHeader *h = realloc(old, sizeof(memHeader) + size);
+    if (!h) return NULL;
+    h->size = size;
+    // Growth counts as an allocation of the subsystem that owns the block
+    memTrack((int)h->sys, size, oldSize, 1, 1);
+    return h + 1;
+}
+
+char* memStrdup(int sys, const char *text) {
+    size_t len = strlen(text) + 1;
+    char *copy = memAlloc(sys, len);
+    if (copy) memcpy(copy, text, len);
+    return copy;
+}
+
+void memFree(void *ptr) {
+    if (!ptr) return;
+    memHeader *h = (memHeader *)ptr - 1;
+    memTrack((int)h->sys, 0, h->size, 0, 1);
+    free(h);
+}
+
+void memReport(FILE *out) {
+    fprintf(out, "=============== Memory by subsystem ===============\n");
+    fprintf(out, "%-12s %10s %10s %12s %12s\n", "Subsystem", "Allocs", "Frees", "Live(B)", "Peak(B)");
+    for (int i = 0; i <= MEM_SUBSYSTEMS; i++) {
+        memCounters *c = i < MEM_SUBSYSTEMS ? &memStats[i] : &memTotal;
+        if (i < MEM_SUBSYSTEMS && !atomic_load(&c->allocs)) continue;
+        fprintf(out, "%-12s %10zu %10zu %12zu %12zu\n", i < MEM_SUBSYSTEMS ? memNames[i] : "total",
+                atomic_load(&c->allocs), atomic_load(&c->frees), atomic_load(&c->live), atomic_load(&c->peak));
+    }
+    fprintf(out, "===================================================\n");
+}
+
+static void memReportToStderr(void) {
+    memReport(stderr);
+}
+
+void memReportAtExit(void) {
+    if (getenv("SPYC_MEMSTATS")) atexit(memReportToStderr);
+}
+
+#endif
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Runs every tests/*.spc through the interpreter and compares its output with
+# the matching .out file.
+#
+#   usage: tests/run.sh [path-to-interpreter]    (default ./a)
+
+SPYC=${1:-./a}
+DIR=$(dirname "$0")
+failed=0
+
+for script in "$DIR"/*.spc; do
+    expected=${script%.spc}.out
+    if "$SPYC" --no-trace "$script" 2>&1 | cmp -s - "$expected"; then
+        echo "ok   $(basename "$script")"
+    else
+        echo "FAIL $(basename "$script")"
+        failed=1
+    fi
+done
+exit $failed